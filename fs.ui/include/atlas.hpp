@@ -0,0 +1,233 @@
+#ifndef FS_UI_ATLAS
+#define FS_UI_ATLAS
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <filesystem>
+#include <glm/glm.hpp>
+
+#include "../../../engine/include/common.hpp"
+#include "../../../engine/include/utils/stbi_global.hpp"
+#include "render.hpp"
+
+namespace Firesteel {
+	//Packs rectangles into a fixed area, keeping track of the top edge ("skyline") of what is placed.
+	//New rectangle goes where its top ends lowest (bottom-left rule).
+	class SkylinePacker {
+	public:
+		SkylinePacker(const int tWidth = 0, const int tHeight = 0) { reset(tWidth, tHeight); }
+
+		void reset(const int tWidth, const int tHeight) {
+			mWidth = tWidth;
+			mHeight = tHeight;
+			mUsedArea = 0;
+			mSkyline.clear();
+			if(tWidth > 0) mSkyline.push_back({ 0, 0, tWidth });
+		}
+		//Finds place for given rectangle. Returns false if there is none.
+		bool pack(const int tWidth, const int tHeight, glm::ivec2& tPosition) {
+			if(tWidth <= 0 || tHeight <= 0) return false;
+			int bestTop = mHeight + 1, bestWidth = mWidth + 1;
+			size_t best = mSkyline.size();
+			for(size_t i = 0; i < mSkyline.size(); i++) {
+				int y = _fit(i, tWidth, tHeight);
+				if(y < 0) continue;
+				if(y + tHeight < bestTop || (y + tHeight == bestTop && mSkyline[i].width < bestWidth)) {
+					best = i;
+					bestTop = y + tHeight;
+					bestWidth = mSkyline[i].width;
+					tPosition = glm::ivec2(mSkyline[i].x, y);
+				}
+			}
+			if(best == mSkyline.size()) return false;
+			_place(best, tPosition, tWidth, tHeight);
+			mUsedArea += static_cast<size_t>(tWidth) * tHeight;
+			return true;
+		}
+
+		int getWidth() const { return mWidth; }
+		int getHeight() const { return mHeight; }
+		//Part of area taken by packed rectangles, [0;1].
+		float getOccupancy() const {
+			return mWidth > 0 && mHeight > 0 ? static_cast<float>(mUsedArea) / (static_cast<float>(mWidth) * mHeight) : 0;
+		}
+	private:
+		struct Node {
+			int x, y, width;
+		};
+
+		//Y at which rectangle fits starting at given node or -1.
+		int _fit(size_t tIndex, const int tWidth, const int tHeight) const {
+			int x = mSkyline[tIndex].x;
+			if(x + tWidth > mWidth) return -1;
+			int left = tWidth, y = 0;
+			while(left > 0) {
+				y = y > mSkyline[tIndex].y ? y : mSkyline[tIndex].y;
+				if(y + tHeight > mHeight) return -1;
+				left -= mSkyline[tIndex].width;
+				tIndex++;
+			}
+			return y;
+		}
+		void _place(const size_t tIndex, const glm::ivec2 tPosition, const int tWidth, const int tHeight) {
+			mSkyline.insert(mSkyline.begin() + tIndex, { tPosition.x, tPosition.y + tHeight, tWidth });
+			//Cut nodes now hidden under the new one.
+			for(size_t i = tIndex + 1; i < mSkyline.size();) {
+				int end = mSkyline[i - 1].x + mSkyline[i - 1].width;
+				if(mSkyline[i].x >= end) break;
+				int shrink = end - mSkyline[i].x;
+				mSkyline[i].x += shrink;
+				mSkyline[i].width -= shrink;
+				if(mSkyline[i].width > 0) break;
+				mSkyline.erase(mSkyline.begin() + i);
+			}
+			//Merge neighbours of same height.
+			for(size_t i = 0; i + 1 < mSkyline.size();) {
+				if(mSkyline[i].y == mSkyline[i + 1].y) {
+					mSkyline[i].width += mSkyline[i + 1].width;
+					mSkyline.erase(mSkyline.begin() + i + 1);
+				}
+				else i++;
+			}
+		}
+
+		int mWidth = 0, mHeight = 0;
+		size_t mUsedArea = 0;
+		std::vector<Node> mSkyline;
+	};
+
+	//Place of an image inside an atlas page.
+	struct AtlasRegion {
+		unsigned int texture = 0;		// Page texture.
+		int page = -1;
+		glm::vec4 uv{0, 0, 1, 1};		// Top left and bottom right UV.
+		glm::ivec2 position{0};			// In pixels.
+		glm::ivec2 size{0};
+
+		bool isValid() const { return page >= 0; }
+	};
+
+	//RGBA pages filled at runtime with sprite images (and glyphs of Text objects that share it).
+	//Everything drawn from one page goes through SpriteBatch in one call.
+	//Pages are added when previous ones are full.
+	class TextureAtlas {
+	public:
+		TextureAtlas(const int tPageSize = 2048, const int tPadding = 1)
+			: mPageSize(tPageSize), mPadding(tPadding) { }
+		~TextureAtlas() { remove(); }
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		//Loads image into atlas (once per file). Images are flipped like Sprite textures.
+		AtlasRegion addImage(const std::string& tPath) {
+			std::error_code ec;
+			std::string key = std::filesystem::weakly_canonical(tPath, ec).string();
+			if(ec) key = tPath;
+			auto it = mRegions.find(key);
+			if(it != mRegions.end()) return it->second;
+			if(!std::filesystem::exists(tPath)) return AtlasRegion();
+			int width = 0, height = 0, channels = 0;
+			//GL thread only, so the global flag is fine (and there in any stb_image version).
+			stbi_set_flip_vertically_on_load(1);
+			unsigned char* pixels = stbi_load(tPath.c_str(), &width, &height, &channels, 4);
+			if(!pixels) {
+				LOG_WARN("Couldn't decode image \"" + tPath + "\" for atlas.");
+				return AtlasRegion();
+			}
+			AtlasRegion region = add(pixels, width, height);
+			stbi_image_free(pixels);
+			if(region.isValid()) mRegions[key] = region;
+			return region;
+		}
+		//Adds RGBA pixels (rows from top).
+		AtlasRegion add(const unsigned char* tPixels, const int tWidth, const int tHeight) {
+			AtlasRegion region;
+			glm::ivec2 position;
+			size_t page = 0;
+			for(; page < mPages.size(); page++)
+				if(mPages[page].packer.pack(tWidth + mPadding, tHeight + mPadding, position)) break;
+			if(page == mPages.size()) {
+				if(tWidth + mPadding > mPageSize || tHeight + mPadding > mPageSize) {
+					LOG_WARN("Image of " + std::to_string(tWidth) + "x" + std::to_string(tHeight) + " doesn't fit into atlas page.");
+					return region;
+				}
+				_addPage();
+				mPages.back().packer.pack(tWidth + mPadding, tHeight + mPadding, position);
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTextureSubImage2D(mPages[page].texture, 0, position.x, position.y, tWidth, tHeight, GL_RGBA, GL_UNSIGNED_BYTE, tPixels);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			region.texture = mPages[page].texture;
+			region.page = static_cast<int>(page);
+			region.position = position;
+			region.size = glm::ivec2(tWidth, tHeight);
+			float size = static_cast<float>(mPageSize);
+			region.uv = glm::vec4(position.x / size, position.y / size,
+				(position.x + tWidth) / size, (position.y + tHeight) / size);
+			return region;
+		}
+		//Adds 8-bit coverage (glyph bitmap) as (a,a,a,a), so it can be drawn with SpriteBatch::FLAG_FONT
+		//or by font shaders that read red channel.
+		AtlasRegion addAlpha(const unsigned char* tAlpha, const int tWidth, const int tHeight, const int tPitch = 0) {
+			int pitch = tPitch ? tPitch : tWidth;
+			mScratch.resize(static_cast<size_t>(tWidth) * tHeight * 4);
+			for(int y = 0; y < tHeight; y++)
+				for(int x = 0; x < tWidth; x++) {
+					unsigned char a = tAlpha[y * pitch + x];
+					unsigned char* p = &mScratch[(static_cast<size_t>(y) * tWidth + x) * 4];
+					p[0] = p[1] = p[2] = p[3] = a;
+				}
+			return add(mScratch.data(), tWidth, tHeight);
+		}
+		//Region of image added by addImage() (invalid if there is none).
+		AtlasRegion find(const std::string& tPath) const {
+			std::error_code ec;
+			std::string key = std::filesystem::weakly_canonical(tPath, ec).string();
+			if(ec) key = tPath;
+			auto it = mRegions.find(key);
+			return it == mRegions.end() ? AtlasRegion() : it->second;
+		}
+
+		void remove() {
+			for(Page& page : mPages) glDeleteTextures(1, &page.texture);
+			UIRender::trackDeleted(mPages.size());
+			mPages.clear();
+			mRegions.clear();
+		}
+
+		size_t getPageCount() const { return mPages.size(); }
+		unsigned int getPageTexture(const size_t tPage) const { return tPage < mPages.size() ? mPages[tPage].texture : 0; }
+		int getPageSize() const { return mPageSize; }
+		float getOccupancy(const size_t tPage) const { return tPage < mPages.size() ? mPages[tPage].packer.getOccupancy() : 0; }
+	private:
+		struct Page {
+			unsigned int texture;
+			SkylinePacker packer;
+		};
+
+		void _addPage() {
+			Page page{ 0, SkylinePacker(mPageSize, mPageSize) };
+			glGenTextures(1, &page.texture);
+			glBindTexture(GL_TEXTURE_2D, page.texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mPageSize, mPageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			//Empty page has to be transparent, so padding doesn't bleed garbage.
+			unsigned char clear[4] = { 0, 0, 0, 0 };
+			glClearTexImage(page.texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, clear);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			UIRender::trackCreated();
+			mPages.push_back(page);
+		}
+
+		int mPageSize, mPadding;
+		std::vector<Page> mPages;
+		std::unordered_map<std::string, AtlasRegion> mRegions;
+		std::vector<unsigned char> mScratch;
+	};
+}
+
+#endif // !FS_UI_ATLAS
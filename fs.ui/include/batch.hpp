@@ -0,0 +1,279 @@
+#ifndef FS_UI_BATCH
+#define FS_UI_BATCH
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+
+#include "../../../engine/include/common.hpp"
+#include "../../../engine/include/shader.hpp"
+#include "render.hpp"
+
+namespace Firesteel {
+	//Order in which batched sprites are drawn.
+	enum SpriteSortMode {
+		SSM_TEXTURE=0,		// By Z, then shader, then texture (fewest draw calls).
+		SSM_SUBMISSION		// As submitted, only neighbours with same state are merged.
+	};
+
+	//Per-sprite data, one instance of the quad each.
+	struct SpriteInstance {
+		glm::vec4 positionRotation;	// X, Y, Z and rotation in radians.
+		glm::vec4 sizeFlags;		// Width, height, flags (see SpriteBatch) and padding.
+		glm::vec4 color;
+		glm::vec4 uvRect;			// Top left and bottom right UV.
+	};
+
+	//Collects sprites between begin() and end() and draws them with one instanced call
+	//per texture/shader run. Transform is done in the vertex shader.
+	//Custom shaders must take the same instance attributes as the built-in one (see sVertex).
+	class SpriteBatch {
+	public:
+		static const unsigned int FLAG_TEXTURE = 1;
+		static const unsigned int FLAG_FONT = 2; // Red channel is alpha.
+		static const unsigned int FLAG_PREMULTIPLIED = 4; // Texture has color multiplied by alpha (rendered UI layers).
+
+		bool initialize(const size_t tReserve = 1024) {
+			if(mProgram) return true;
+			mProgram = UIRender::compileProgram(sVertex, sFragment);
+			if(!mProgram) return false;
+			UnitQuad::acquire();
+			glGenVertexArrays(1, &mVAO);
+			glGenBuffers(1, &mInstanceVBO);
+			UIRender::trackCreated(2);
+			glBindVertexArray(mVAO);
+			//Per-vertex data comes from the shared quad, per-instance data from own buffer.
+			UnitQuad::bindAttributes();
+			_reserve(tReserve);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindVertexArray(0);
+			mInstances.reserve(tReserve);
+			mItems.reserve(tReserve);
+			return true;
+		}
+
+		void begin(const glm::vec2 tProjectionSize, const SpriteSortMode tMode = SSM_TEXTURE) {
+			mProjectionSize = tProjectionSize;
+			mMode = tMode;
+			mItems.clear();
+			mInstances.clear();
+		}
+		//Same parameters as Sprite::draw. UV rect is top left and bottom right corners.
+		void draw(const unsigned int tTexture, glm::vec3 tPosition, const glm::vec2 tSize, const float tPitchRotation = 0,
+			const glm::vec4 tColor = glm::vec4(1), const glm::vec4 tUVRect = glm::vec4(0, 0, 1, 1),
+			const unsigned int tFlags = FLAG_TEXTURE, const Shader* tShader = nullptr) {
+			unsigned int flags = tTexture ? tFlags : 0;
+			mItems.push_back({ tShader ? tShader->ID : 0, flags ? tTexture : 0, tPosition.z, static_cast<unsigned int>(mInstances.size()) });
+			mInstances.push_back({
+				glm::vec4(tPosition, glm::radians(tPitchRotation)),
+				glm::vec4(tSize, static_cast<float>(flags), 0),
+				tColor,
+				tUVRect
+			});
+		}
+		//Sorts collected sprites, uploads them with one buffer write and draws them.
+		void end() {
+			mDrawCalls = 0;
+			mRuns.clear();
+			mPatchBegin = mPatchEnd = 0;
+			if(mItems.empty() || !mProgram) return;
+			if(mMode == SSM_TEXTURE)
+				std::stable_sort(mItems.begin(), mItems.end(), [](const Item& tA, const Item& tB) {
+					if(tA.z != tB.z) return tA.z < tB.z;
+					if(tA.program != tB.program) return tA.program < tB.program;
+					return tA.texture < tB.texture;
+				});
+			//Instances go to GPU in draw order, so every run is a contiguous range.
+			mSorted.resize(mItems.size());
+			mSlots.resize(mItems.size());
+			for(size_t i = 0; i < mItems.size(); i++) {
+				mSorted[i] = mInstances[mItems[i].instance];
+				mSlots[mItems[i].instance] = static_cast<unsigned int>(i);
+			}
+			size_t start = 0;
+			for(size_t i = 1; i <= mItems.size(); i++) {
+				if(i < mItems.size() && mItems[i].program == mItems[start].program && mItems[i].texture == mItems[start].texture)
+					continue;
+				mRuns.push_back({ mItems[start].program ? mItems[start].program : mProgram, mItems[start].texture,
+					static_cast<unsigned int>(start), static_cast<int>(i - start) });
+				start = i;
+			}
+			glBindVertexArray(mVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+			if(mSorted.size() > mCapacity) _reserve(mSorted.size() * 2);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, mSorted.size() * sizeof(SpriteInstance), mSorted.data());
+			_drawRuns();
+		}
+		//Draws sprites of the last end() again without sorting or uploading them (retained UI, see Canvas).
+		//Only sprites changed by patch() are uploaded.
+		void redraw() {
+			mDrawCalls = 0;
+			if(mRuns.empty() || !mProgram) return;
+			glBindVertexArray(mVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+			if(mPatchEnd > mPatchBegin)
+				glBufferSubData(GL_ARRAY_BUFFER, mPatchBegin * sizeof(SpriteInstance), (mPatchEnd - mPatchBegin) * sizeof(SpriteInstance),
+					mSorted.data() + mPatchBegin);
+			mPatchBegin = mPatchEnd = 0;
+			_drawRuns();
+		}
+		//Replaces sprites of the last end() starting from given submission index with everything submitted to tSource
+		//(a batch that was only begin()'d and drawn into). Sprites have to keep texture, shader and depth,
+		//so draw order stays the same. Returns false if they don't (submit everything again then).
+		bool patch(const size_t tFirst, const SpriteBatch& tSource) {
+			if(tFirst + tSource.mItems.size() > mSlots.size()) return false;
+			for(size_t i = 0; i < tSource.mItems.size(); i++) {
+				const Item& was = mItems[mSlots[tFirst + i]];
+				const Item& now = tSource.mItems[i];
+				if(was.program != now.program || was.texture != now.texture || was.z != now.z) return false;
+			}
+			for(size_t i = 0; i < tSource.mItems.size(); i++) {
+				size_t slot = mSlots[tFirst + i];
+				mSorted[slot] = mInstances[tFirst + i] = tSource.mInstances[tSource.mItems[i].instance];
+				if(mPatchEnd == mPatchBegin) { mPatchBegin = slot; mPatchEnd = slot + 1; }
+				else {
+					mPatchBegin = std::min(mPatchBegin, slot);
+					mPatchEnd = std::max(mPatchEnd, slot + 1);
+				}
+			}
+			return true;
+		}
+
+		//Box (min and max, window pixels from top left) covering given range of submitted sprites.
+		//Empty range gives min above max.
+		glm::vec4 getBounds(const size_t tFirst, const size_t tCount) const {
+			glm::vec4 bounds(1e30f, 1e30f, -1e30f, -1e30f);
+			for(size_t i = tFirst; i < tFirst + tCount && i < mInstances.size(); i++) {
+				const SpriteInstance& sprite = mInstances[i];
+				//Same transform as the vertex shader.
+				float s = glm::sin(sprite.positionRotation.w), c = glm::cos(sprite.positionRotation.w);
+				glm::vec2 origin(sprite.positionRotation.x, mProjectionSize.y - sprite.positionRotation.y);
+				for(glm::vec2 corner : { glm::vec2(0), glm::vec2(1, 0), glm::vec2(1), glm::vec2(0, 1) }) {
+					glm::vec2 local = corner * glm::vec2(sprite.sizeFlags);
+					glm::vec2 p = origin + glm::vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+					bounds = glm::vec4(glm::min(glm::vec2(bounds), p), glm::max(glm::vec2(bounds.z, bounds.w), p));
+				}
+			}
+			return bounds;
+		}
+
+		void remove() {
+			if(!mProgram) return;
+			glDeleteVertexArrays(1, &mVAO);
+			glDeleteBuffers(1, &mInstanceVBO);
+			glDeleteProgram(mProgram);
+			UIRender::trackDeleted(3);
+			UnitQuad::release();
+			mVAO = mInstanceVBO = mProgram = 0;
+			mCapacity = 0;
+		}
+		~SpriteBatch() { remove(); }
+
+		//Stats of the last end() or redraw().
+		size_t getDrawCalls() const { return mDrawCalls; }
+		size_t getSpriteCount() const { return mItems.size(); }
+		unsigned int getProgram() const { return mProgram; }
+	private:
+		struct Item {
+			unsigned int program, texture;
+			float z;
+			unsigned int instance;
+		};
+		//Consecutive sprites drawn by one call.
+		struct Run {
+			unsigned int program, texture;
+			unsigned int first;
+			int count;
+		};
+
+		//Issues draw calls of the last end(). Expects VAO to be bound.
+		void _drawRuns() {
+			glActiveTexture(GL_TEXTURE0);
+			const glm::mat4 projection = glm::ortho(0.f, mProjectionSize.x, mProjectionSize.y, 0.f);
+			unsigned int boundProgram = 0, boundTexture = 0;
+			for(const Run& run : mRuns) {
+				if(run.program != boundProgram || mDrawCalls == 0) {
+					glUseProgram(run.program);
+					glUniformMatrix4fv(glGetUniformLocation(run.program, "projection"), 1, GL_FALSE, &projection[0][0]);
+					glUniform1f(glGetUniformLocation(run.program, "viewHeight"), mProjectionSize.y);
+					glUniform1i(glGetUniformLocation(run.program, "tex"), 0);
+					boundProgram = run.program;
+				}
+				if(run.texture != boundTexture || mDrawCalls == 0) {
+					glBindTexture(GL_TEXTURE_2D, run.texture);
+					boundTexture = run.texture;
+				}
+				glDrawElementsInstancedBaseInstance(GL_TRIANGLES, UnitQuad::INDEX_COUNT, UnitQuad::INDEX_TYPE, (void*)0,
+					run.count, run.first);
+				mDrawCalls++;
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindVertexArray(0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glUseProgram(0);
+		}
+
+		//(Re)allocates instance buffer. Expects VAO and instance VBO to be bound.
+		void _reserve(const size_t tCount) {
+			mCapacity = tCount < 64 ? 64 : tCount;
+			glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+			glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(SpriteInstance), nullptr, GL_DYNAMIC_DRAW);
+			for(unsigned int i = 0; i < 4; i++) {
+				glEnableVertexAttribArray(1 + i);
+				glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)(i * sizeof(glm::vec4)));
+				glVertexAttribDivisor(1 + i, 1);
+			}
+		}
+
+		static constexpr const char* sVertex = R"(#version 330 core
+layout(location = 0) in vec4 aVertex;
+layout(location = 1) in vec4 iPositionRotation;
+layout(location = 2) in vec4 iSizeFlags;
+layout(location = 3) in vec4 iColor;
+layout(location = 4) in vec4 iUVRect;
+uniform mat4 projection;
+uniform float viewHeight;
+out vec2 vUV;
+out vec4 vColor;
+flat out int vFlags;
+void main() {
+	float s = sin(iPositionRotation.w), c = cos(iPositionRotation.w);
+	vec2 local = aVertex.xy * iSizeFlags.xy;
+	vec2 world = vec2(iPositionRotation.x, viewHeight - iPositionRotation.y) + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+	gl_Position = projection * vec4(world, iPositionRotation.z, 1.0);
+	vUV = mix(iUVRect.xy, iUVRect.zw, aVertex.zw);
+	vColor = iColor;
+	vFlags = int(iSizeFlags.z);
+})";
+		static constexpr const char* sFragment = R"(#version 330 core
+in vec2 vUV;
+in vec4 vColor;
+flat in int vFlags;
+uniform sampler2D tex;
+out vec4 fragColor;
+void main() {
+	vec4 color = vColor;
+	if((vFlags & 1) != 0) {
+		vec4 texel = texture(tex, vUV);
+		if((vFlags & 2) != 0) color.a *= texel.r;
+		else if((vFlags & 4) != 0) color *= texel.a > 0.0 ? vec4(texel.rgb / texel.a, texel.a) : vec4(0.0);
+		else color *= texel;
+	}
+	fragColor = color;
+})";
+
+		unsigned int mVAO = 0, mInstanceVBO = 0, mProgram = 0;
+		size_t mCapacity = 0, mDrawCalls = 0;
+		size_t mPatchBegin = 0, mPatchEnd = 0;		// Sorted range changed since last upload.
+		glm::vec2 mProjectionSize{0};
+		SpriteSortMode mMode = SSM_TEXTURE;
+		std::vector<Item> mItems;
+		std::vector<SpriteInstance> mInstances, mSorted;
+		std::vector<unsigned int> mSlots;		// Place of each submitted sprite in sorted order.
+		std::vector<Run> mRuns;
+	};
+}
+
+#endif // !FS_UI_BATCH
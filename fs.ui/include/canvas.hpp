@@ -0,0 +1,712 @@
+#ifndef FS_UI_CANVAS
+#define FS_UI_CANVAS
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "batch.hpp"
+#include "generic.hpp"
+#include "text.hpp"
+#include "input.hpp"
+#include "layout.hpp"
+
+namespace Firesteel {
+	enum CanvasNodeType {
+		CNT_GROUP=0,		// Only holds children.
+		CNT_ELEMENT,		// UIElement (not owned by canvas).
+		CNT_TEXT			// String drawn with a font.
+	};
+
+	class CanvasNode;
+
+	//What cached layers of a canvas cost and save.
+	struct CanvasLayerStats {
+		size_t hits = 0;			// Layer frames composited without rendering anything.
+		size_t partialRenders = 0;	// Layer frames that re-rendered dirty rectangle only.
+		size_t fullRenders = 0;
+		size_t layers = 0;			// Cached by last recording.
+		size_t overBudget = 0;		// Drawn uncached by last recording, as they didn't fit the budget.
+		size_t bytes = 0;			// Held by layer textures.
+
+		float getHitRate() const {
+			size_t frames = hits + partialRenders + fullRenders;
+			return frames ? static_cast<float>(hits) / frames : 0.f;
+		}
+	};
+
+	//Texture a cached subtree is rendered into (see Canvas::setCached()).
+	//Covers on-screen bounds of the subtree only.
+	class CanvasLayer {
+		friend class Canvas;
+	public:
+		~CanvasLayer() { _release(); }
+
+		//Window pixels (x and y from top left, width, height) layer texture covers.
+		glm::ivec4 getRect() const { return mRect; }
+		bool isCached() const { return mTexture != 0; }
+		unsigned int getTexture() const { return mTexture; }
+		size_t getBytes() const { return mTexture ? static_cast<size_t>(mSize.x) * mSize.y * 4 : 0; }
+	private:
+		SpriteBatch mBatch;
+		float mZ = 0;
+		CanvasNode* mParent = nullptr;		// Layer node whose texture shows this layer (none if on screen).
+		unsigned int mFramebuffer = 0, mTexture = 0;
+		glm::ivec2 mSize{0};
+		glm::ivec4 mRect{0};
+		bool mFull = true;					// Recorded again, needs whole render.
+		glm::vec4 mDirty{1e30f, 1e30f, -1e30f, -1e30f};
+
+		bool _allocate(const glm::ivec2 tSize) {
+			if(mTexture && tSize == mSize) return true;
+			_release();
+			mSize = tSize;
+			glGenTextures(1, &mTexture);
+			glBindTexture(GL_TEXTURE_2D, mTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mSize.x, mSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			//Texels map 1:1 to screen pixels.
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			int previous = 0;
+			glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+			glGenFramebuffers(1, &mFramebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTexture, 0);
+			bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+			glBindFramebuffer(GL_FRAMEBUFFER, previous);
+			UIRender::trackCreated(2);
+			if(!complete) {
+				LOG_ERRR("Couldn't create framebuffer for UI layer.");
+				_release();
+			}
+			return complete;
+		}
+		void _release() {
+			if(!mTexture) return;
+			glDeleteFramebuffers(1, &mFramebuffer);
+			glDeleteTextures(1, &mTexture);
+			UIRender::trackDeleted(2);
+			mFramebuffer = mTexture = 0;
+			mSize = glm::ivec2(0);
+		}
+		void _addDirty(const glm::vec4 tRect) {
+			mDirty = glm::vec4(glm::min(glm::vec2(mDirty), glm::vec2(tRect)), glm::max(glm::vec2(mDirty.z, mDirty.w), glm::vec2(tRect.z, tRect.w)));
+		}
+	};
+
+	//Node of Canvas tree. Made, changed and freed through Canvas only.
+	class CanvasNode {
+		friend class Canvas;
+	public:
+		CanvasNodeType getType() const { return mType; }
+		CanvasNode* getParent() const { return mParent; }
+		const std::vector<std::unique_ptr<CanvasNode>>& getChildren() const { return mChildren; }
+		UIElement* getElement() const { return mElement; }
+		const std::string& getText() const { return mText; }
+		glm::vec3 getPosition() const { return mPosition; }
+		//Own flag, node is drawn only if all parents are visible too.
+		bool isVisible() const { return mVisible; }
+		//Render target of the subtree if it's cached, otherwise nullptr.
+		const CanvasLayer* getLayer() const { return mLayer.get(); }
+		//Layout constraints, nullptr if node is placed by hand.
+		const LayoutStyle* getLayout() const { return mHasLayout ? &mStyle : nullptr; }
+		//Box given by last layout: x, y (window pixels from top left), width, height.
+		glm::vec4 getBox() const { return mBox; }
+	private:
+		CanvasNodeType mType = CNT_GROUP;
+		CanvasNode* mParent = nullptr;
+		std::vector<std::unique_ptr<CanvasNode>> mChildren;
+		bool mVisible = true, mDirty = false;
+		UIElement* mElement = nullptr;
+		Text* mFont = nullptr;
+		std::string mText;
+		glm::vec3 mPosition{0};		// Of text (baseline start).
+		glm::vec2 mScale{1};
+		glm::vec4 mColor{1};		// Of text, or element's state color when it was recorded.
+		std::unique_ptr<CanvasLayer> mLayer;
+		bool mHasLayout = false;
+		bool mMeasureDirty = true;		// Size of content has to be measured again.
+		bool mLayoutDirty = true;		// Node or something below it has to be laid out again.
+		LayoutStyle mStyle;
+		glm::vec2 mIntrinsic{0};		// Content size of leaf elements (their size when layout was set).
+		glm::vec2 mMeasured{0};
+		glm::vec4 mBox{-1};
+		CanvasNode* mOwner = nullptr;	// Layer node sprites of this node were recorded into (none for canvas batch).
+		//Sprites of the node in its batch (as submission range).
+		size_t mFirst = 0, mCount = 0;
+	};
+
+	//Retained UI: tree of elements and labels drawn from a draw list kept on the GPU.
+	//Element setters and canvas setters mark nodes dirty. Frame with nothing dirty only re-issues
+	//last frame's draw calls (no tree walk, no upload). Dirty nodes that keep their sprite count, textures
+	//and depth are patched in place, other changes (structure, visibility, text length) re-record the tree.
+	//Changes made to elements around their setters (state colors, sprite) need invalidate().
+	//Subtrees that rarely change can be cached (see setCached()).
+	class Canvas : public UIElementObserver {
+	public:
+		Canvas(const float tInputCellSize = 64) : mRoot(new CanvasNode()), mInput(tInputCellSize) { }
+		~Canvas() { clear(); }
+		Canvas(const Canvas&) = delete;
+		Canvas& operator=(const Canvas&) = delete;
+
+		bool initialize(const size_t tReserve = 1024) { return mBatch.initialize(tReserve); }
+		//Frees nodes and GPU buffers.
+		void remove() {
+			clear();
+			mBatch.remove();
+		}
+		//Frees all nodes. Elements stay alive, but are no longer observed.
+		void clear() {
+			for(auto& child : mRoot->mChildren) _unregister(child.get());
+			mRoot->mChildren.clear();
+			mDirty.clear();
+			mFonts.clear();
+			mLayoutRoots.clear();
+			mStructureDirty = true;
+		}
+
+		CanvasNode* getRoot() { return mRoot.get(); }
+		CanvasNode* addGroup(CanvasNode* tParent = nullptr) {
+			return _attach(new CanvasNode(), tParent);
+		}
+		//Element has to stay at one address while in canvas. Destroyed elements leave canvas by themselves
+		//(their nodes become groups, so children stay). Returns nullptr if element is already in canvas.
+		CanvasNode* addElement(UIElement* tElement, CanvasNode* tParent = nullptr) {
+			if(!tElement || mElements.count(tElement)) return nullptr;
+			CanvasNode* node = new CanvasNode();
+			node->mType = CNT_ELEMENT;
+			node->mElement = tElement;
+			mElements[tElement] = node;
+			mInput.add(tElement);
+			//Canvas listens and forwards to its input.
+			tElement->setObserver(this);
+			return _attach(node, tParent);
+		}
+		//Position is baseline start, as in Text::draw(). Font has to outlive the node.
+		//Canvas draws text through SpriteBatch, so SDF fonts aren't supported (nodes stay empty).
+		CanvasNode* addText(Text& tFont, const std::string& tText, const glm::vec3 tPosition,
+			const glm::vec2 tScale = glm::vec2(1), const glm::vec4 tColor = glm::vec4(1), CanvasNode* tParent = nullptr) {
+			if(tFont.getMode() == TRM_SDF) LOG_WARN("Canvas can't draw SDF font, text node \"" + tText + "\" stays empty.");
+			CanvasNode* node = new CanvasNode();
+			node->mType = CNT_TEXT;
+			node->mFont = &tFont;
+			node->mText = tText;
+			node->mPosition = tPosition;
+			node->mScale = tScale;
+			node->mColor = tColor;
+			return _attach(node, tParent);
+		}
+		//Frees node with its whole subtree.
+		void removeNode(CanvasNode* tNode) {
+			if(!tNode || !tNode->mParent) return;
+			if(tNode->mHasLayout && tNode->mParent->mHasLayout) _markLayout(tNode->mParent);
+			mLayoutRootsDirty = true;
+			_unregister(tNode);
+			auto& siblings = tNode->mParent->mChildren;
+			siblings.erase(std::find_if(siblings.begin(), siblings.end(),
+				[tNode](const std::unique_ptr<CanvasNode>& tChild) { return tChild.get() == tNode; }));
+			mStructureDirty = true;
+		}
+
+		void setVisible(CanvasNode* tNode, const bool tVisible) {
+			if(!tNode || tNode->mVisible == tVisible) return;
+			tNode->mVisible = tVisible;
+			mStructureDirty = true;
+			if(tNode->mHasLayout) _markLayout(tNode);
+		}
+		void setText(CanvasNode* tNode, const std::string& tText) {
+			if(!tNode || tNode->mType != CNT_TEXT || tNode->mText == tText) return;
+			tNode->mText = tText;
+			_markDirty(tNode);
+			if(tNode->mHasLayout) _markLayout(tNode);
+		}
+		void setColor(CanvasNode* tNode, const glm::vec4 tColor) {
+			if(!tNode || tNode->mType != CNT_TEXT || tNode->mColor == tColor) return;
+			tNode->mColor = tColor;
+			_markDirty(tNode);
+		}
+		void setPosition(CanvasNode* tNode, const glm::vec3 tPosition) {
+			if(!tNode || tNode->mType != CNT_TEXT || tNode->mPosition == tPosition) return;
+			tNode->mPosition = tPosition;
+			_markDirty(tNode);
+		}
+		//Node will be recorded again on next draw().
+		void invalidate(CanvasNode* tNode) { if(tNode) _markDirty(tNode); }
+
+		//Cached subtree is rendered once into a texture and drawn as one quad at given depth
+		//(so its own depths only order it inside). Changes of its nodes re-render only the rectangles they cover.
+		//Layers that don't fit the memory budget are drawn as if they weren't cached.
+		void setCached(CanvasNode* tNode, const bool tCached, const float tZ = 0) {
+			if(!tNode) return;
+			if(tCached) {
+				if(!tNode->mLayer) tNode->mLayer.reset(new CanvasLayer());
+				tNode->mLayer->mZ = tZ;
+			} else tNode->mLayer.reset();
+			mStructureDirty = true;
+		}
+		//Node gets position and size from layout, along with its children that have layout.
+		//Nodes without layout (and layout nodes under them, which are laid out against the window) keep their own placement.
+		//Leaf element without fixed size keeps the size it has now. Layout runs on draw(), or earlier with layout().
+		void setLayout(CanvasNode* tNode, const LayoutStyle& tStyle) {
+			if(!tNode || tNode == mRoot.get() || (tNode->mHasLayout && tNode->mStyle == tStyle)) return;
+			if(!tNode->mHasLayout) {
+				if(tNode->mElement) tNode->mIntrinsic = tNode->mElement->getSize();
+				tNode->mHasLayout = true;
+				mLayoutRootsDirty = true;
+			}
+			tNode->mStyle = tStyle;
+			_markLayout(tNode);
+		}
+		void clearLayout(CanvasNode* tNode) {
+			if(!tNode || !tNode->mHasLayout) return;
+			_markLayout(tNode);
+			tNode->mHasLayout = false;
+			mLayoutRootsDirty = true;
+		}
+		//Lays out nodes whose constraints or content changed, and whatever they move.
+		void layout(const glm::vec2 tProjectionSize) {
+			mLayoutVisits = 0;
+			//Boxes are from window top, positions of elements from its bottom.
+			bool flipped = tProjectionSize.y != mLayoutSize.y, resized = tProjectionSize != mLayoutSize;
+			mLayoutSize = tProjectionSize;
+			if(mLayoutRootsDirty) {
+				mLayoutRoots.clear();
+				_findLayoutRoots(mRoot.get());
+				mLayoutRootsDirty = false;
+			}
+			for(CanvasNode* root : mLayoutRoots) {
+				if(!root->mVisible || (!resized && !root->mLayoutDirty)) continue;
+				const LayoutStyle& s = root->mStyle;
+				glm::vec2 size = _sizeIn(root, mLayoutSize);
+				_arrange(root, glm::vec4(mLayoutSize * s.anchor - size * s.pivot + s.offset, size), flipped);
+			}
+		}
+		//Nodes measured or laid out by last layout().
+		size_t getLayoutVisits() const { return mLayoutVisits; }
+
+		//Bytes all layer textures may take (64 MB by default).
+		void setLayerBudget(const size_t tBytes) {
+			mLayerBudget = tBytes;
+			mStructureDirty = true;
+		}
+		const CanvasLayerStats& getLayerStats() const { return mLayerStats; }
+
+		//Hover and click of elements (see UIInput). Elements whose state color changed get redrawn.
+		void update(const glm::vec2 tProjectionSize) {
+			mHovered = mInput.getHovered();
+			mInput.update(tProjectionSize);
+			_restyle(mHovered);
+			_restyle(mInput.getHovered());
+		}
+		void draw(const glm::vec2 tProjectionSize) {
+			layout(tProjectionSize);
+			if(tProjectionSize != mProjectionSize) {
+				mProjectionSize = tProjectionSize;
+				mStructureDirty = true;
+			}
+			//Glyphs rasterized while recording stay pinned until endBatch(), so later nodes can't evict them.
+			bool batching = TextRenderer::isBatching();
+			if(!batching) TextRenderer::beginBatch();
+			_checkFonts();
+			if(!mStructureDirty && !mDirty.empty()) {
+				_patch();
+				//Patched text may have evicted glyphs of other nodes.
+				_checkFonts();
+			}
+			bool rebuild = mStructureDirty;
+			if(rebuild) _rebuild();
+			if(!batching) TextRenderer::endBatch();
+			_renderLayers();
+			if(rebuild) mBatch.end();
+			else {
+				mBatch.redraw();
+				if(mDirty.empty()) mIdleFrames++;
+			}
+			for(CanvasNode* node : mDirty) node->mDirty = false;
+			mDirty.clear();
+		}
+
+		//Input that dispatches hover and click to canvas elements.
+		UIInput& getInput() { return mInput; }
+		size_t getNodeCount() const { return mNodeCount; }
+		size_t getDrawCalls() const { return mBatch.getDrawCalls(); }
+		//Times the whole tree was recorded again.
+		size_t getRebuilds() const { return mRebuilds; }
+		//Nodes updated in place.
+		size_t getPatches() const { return mPatches; }
+		//Frames drawn without any change.
+		size_t getIdleFrames() const { return mIdleFrames; }
+
+		void onElementChanged(UIElement* tElement) override {
+			mInput.onElementChanged(tElement);
+			auto it = mElements.find(tElement);
+			if(it != mElements.end()) _markDirty(it->second);
+		}
+		void onElementRemoved(UIElement* tElement) override {
+			mInput.onElementRemoved(tElement);
+			auto it = mElements.find(tElement);
+			if(it == mElements.end()) return;
+			it->second->mType = CNT_GROUP;
+			it->second->mElement = nullptr;
+			mElements.erase(it);
+			mStructureDirty = true;
+		}
+	private:
+		CanvasNode* _attach(CanvasNode* tNode, CanvasNode* tParent) {
+			if(!tParent) tParent = mRoot.get();
+			tNode->mParent = tParent;
+			tParent->mChildren.emplace_back(tNode);
+			mNodeCount++;
+			mStructureDirty = true;
+			return tNode;
+		}
+		//Forgets elements and dirty marks of a subtree that is about to be freed.
+		void _unregister(CanvasNode* tNode) {
+			mNodeCount--;
+			if(tNode->mDirty) mDirty.erase(std::find(mDirty.begin(), mDirty.end(), tNode));
+			if(tNode->mElement) {
+				mElements.erase(tNode->mElement);
+				mInput.remove(tNode->mElement);
+				if(tNode->mElement->getObserver() == this) tNode->mElement->setObserver(nullptr);
+			}
+			for(auto& child : tNode->mChildren) _unregister(child.get());
+		}
+		//Marks elements whose state color isn't the recorded one.
+		void _restyle(const std::vector<UIElement*>& tElements) {
+			for(UIElement* element : tElements) {
+				auto it = mElements.find(element);
+				if(it != mElements.end() && it->second->mColor != element->getStateColor()) _markDirty(it->second);
+			}
+		}
+		void _markDirty(CanvasNode* tNode) {
+			if(tNode->mDirty) return;
+			tNode->mDirty = true;
+			mDirty.push_back(tNode);
+		}
+
+		//Submits sprites of the node alone (not its children).
+		void _emit(CanvasNode* tNode, SpriteBatch& tBatch) {
+			if(tNode->mType == CNT_ELEMENT) {
+				tNode->mColor = tNode->mElement->getStateColor();
+				tNode->mElement->draw(tBatch);
+			} else if(tNode->mType == CNT_TEXT)
+				tNode->mFont->draw(tBatch, tNode->mText, tNode->mPosition, tNode->mScale, tNode->mColor);
+		}
+		SpriteBatch& _batchOf(const CanvasNode* tNode) { return tNode->mOwner ? tNode->mOwner->mLayer->mBatch : mBatch; }
+		void _record(CanvasNode* tNode, const bool tVisible, SpriteBatch& tBatch, CanvasNode* tOwner) {
+			bool visible = tVisible && tNode->mVisible;
+			if(tNode->mLayer) {
+				if(!visible) tNode->mLayer->_release();
+				else if(_recordLayer(tNode, tBatch, tOwner)) return;
+			}
+			tNode->mOwner = tOwner;
+			tNode->mFirst = tBatch.getSpriteCount();
+			if(tNode->mType == CNT_TEXT) mFonts.emplace(tNode->mFont, tNode->mFont->getGeneration());
+			if(visible) _emit(tNode, tBatch);
+			tNode->mCount = tBatch.getSpriteCount() - tNode->mFirst;
+			for(auto& child : tNode->mChildren) _record(child.get(), visible, tBatch, tOwner);
+		}
+		//Records subtree into layer's own batch and puts quad showing the layer into the owner's batch.
+		//Returns false if layer can't be cached (subtree has to be recorded as usual then).
+		bool _recordLayer(CanvasNode* tNode, SpriteBatch& tBatch, CanvasNode* tOwner) {
+			CanvasLayer& layer = *tNode->mLayer;
+			size_t layers = mLayers.size(), bytes = mLayerStats.bytes, overBudget = mLayerStats.overBudget;
+			if(!layer.mBatch.initialize()) return false;
+			layer.mBatch.begin(mProjectionSize);
+			tNode->mOwner = tNode;
+			tNode->mFirst = 0;
+			if(tNode->mType == CNT_TEXT) mFonts.emplace(tNode->mFont, tNode->mFont->getGeneration());
+			_emit(tNode, layer.mBatch);
+			tNode->mCount = layer.mBatch.getSpriteCount();
+			for(auto& child : tNode->mChildren) _record(child.get(), true, layer.mBatch, tNode);
+			//Texture covers visible part of the subtree, in whole pixels.
+			glm::vec4 bounds = layer.mBatch.getBounds(0, layer.mBatch.getSpriteCount());
+			glm::ivec2 min = glm::clamp(glm::ivec2(glm::floor(glm::vec2(bounds))), glm::ivec2(0), glm::ivec2(mProjectionSize));
+			glm::ivec2 max = glm::clamp(glm::ivec2(glm::ceil(glm::vec2(bounds.z, bounds.w))), glm::ivec2(0), glm::ivec2(mProjectionSize));
+			layer.mRect = glm::ivec4(min, glm::max(max - min, glm::ivec2(0)));
+			layer.mParent = tOwner;
+			layer.mFull = true;
+			layer.mDirty = glm::vec4(1e30f, 1e30f, -1e30f, -1e30f);
+			if(layer.mRect.z == 0 || layer.mRect.w == 0) {
+				//Nothing on screen, nothing to keep.
+				layer._release();
+				return true;
+			}
+			size_t size = static_cast<size_t>(layer.mRect.z) * layer.mRect.w * 4;
+			if(mLayerStats.bytes + size > mLayerBudget || !layer._allocate(glm::ivec2(layer.mRect.z, layer.mRect.w))) {
+				//Layers inside will be recorded again.
+				mLayers.resize(layers);
+				mLayerStats.bytes = bytes;
+				mLayerStats.overBudget = overBudget + 1;
+				layer._release();
+				return false;
+			}
+			mLayerStats.bytes += size;
+			tBatch.draw(layer.mTexture, glm::vec3(layer.mRect.x, mProjectionSize.y - layer.mRect.y, layer.mZ),
+				glm::vec2(layer.mRect.z, layer.mRect.w), 0, glm::vec4(1), glm::vec4(0, 1, 1, 0),
+				SpriteBatch::FLAG_TEXTURE | SpriteBatch::FLAG_PREMULTIPLIED);
+			//Inner layers come first, so they're rendered before layers showing them.
+			mLayers.push_back(tNode);
+			return true;
+		}
+		void _rebuild() {
+			mFonts.clear();
+			mLayers.clear();
+			mLayerStats.bytes = mLayerStats.overBudget = 0;
+			mBatch.begin(mProjectionSize);
+			_record(mRoot.get(), true, mBatch, nullptr);
+			mLayerStats.layers = mLayers.size();
+			//Generations are taken before a font is first drawn, so evictions during recording are seen
+			//and the next frame records again.
+			mStructureDirty = false;
+			_checkFonts();
+			mRebuilds++;
+		}
+		//Fonts that lost glyphs invalidate all quads made from them.
+		void _checkFonts() {
+			for(const auto& font : mFonts)
+				if(font.first->getGeneration() != font.second) mStructureDirty = true;
+		}
+		void _patch() {
+			for(CanvasNode* node : mDirty) {
+				//Hidden nodes have nothing to update.
+				if(node->mCount == 0 && !_visible(node)) continue;
+				SpriteBatch& batch = _batchOf(node);
+				glm::vec4 before = batch.getBounds(node->mFirst, node->mCount);
+				mScratch.begin(mProjectionSize);
+				_emit(node, mScratch);
+				if(mScratch.getSpriteCount() != node->mCount || !batch.patch(node->mFirst, mScratch)) {
+					mStructureDirty = true;
+					return;
+				}
+				if(node->mOwner) {
+					//Cached layer re-renders what the node covered and covers now, unless node left the layer's texture.
+					CanvasLayer& layer = *node->mOwner->mLayer;
+					glm::vec4 after = batch.getBounds(node->mFirst, node->mCount);
+					glm::vec4 rect(layer.mRect.x, layer.mRect.y, layer.mRect.x + layer.mRect.z, layer.mRect.y + layer.mRect.w);
+					if(node->mCount && (after.x < rect.x || after.y < rect.y || after.z > rect.z || after.w > rect.w)) {
+						mStructureDirty = true;
+						return;
+					}
+					layer._addDirty(before);
+					layer._addDirty(after);
+				}
+				mPatches++;
+			}
+		}
+		//Brings layer textures up to date. Inner layers go first and mark what changed in outer ones.
+		void _renderLayers() {
+			bool pending = false;
+			for(CanvasNode* node : mLayers) {
+				const CanvasLayer& layer = *node->mLayer;
+				pending = pending || layer.mFull || layer.mDirty.x < layer.mDirty.z;
+			}
+			if(!pending) {
+				mLayerStats.hits += mLayers.size();
+				return;
+			}
+			int framebuffer = 0, viewport[4], blend[4];
+			float clear[4];
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			glGetIntegerv(GL_BLEND_SRC_RGB, &blend[0]);
+			glGetIntegerv(GL_BLEND_DST_RGB, &blend[1]);
+			glGetIntegerv(GL_BLEND_SRC_ALPHA, &blend[2]);
+			glGetIntegerv(GL_BLEND_DST_ALPHA, &blend[3]);
+			glGetFloatv(GL_COLOR_CLEAR_VALUE, clear);
+			bool blending = glIsEnabled(GL_BLEND), scissor = glIsEnabled(GL_SCISSOR_TEST);
+			//Layer texture keeps color multiplied by alpha, so it blends over the screen as its content would.
+			glEnable(GL_BLEND);
+			glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+			glClearColor(0, 0, 0, 0);
+			for(CanvasNode* node : mLayers) {
+				CanvasLayer& layer = *node->mLayer;
+				glm::vec4 rect(layer.mRect.x, layer.mRect.y, layer.mRect.x + layer.mRect.z, layer.mRect.y + layer.mRect.w);
+				if(!layer.mFull) {
+					if(layer.mDirty.x >= layer.mDirty.z) {
+						mLayerStats.hits++;
+						continue;
+					}
+					//Edges of rotated or scaled sprites may touch one more pixel.
+					rect = glm::vec4(glm::max(glm::vec2(rect), glm::floor(glm::vec2(layer.mDirty)) - 1.f),
+						glm::min(glm::vec2(rect.z, rect.w), glm::ceil(glm::vec2(layer.mDirty.z, layer.mDirty.w)) + 1.f));
+				}
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, layer.mFramebuffer);
+				//Screen projection shifted so the texture starts at the layer's corner.
+				glViewport(-layer.mRect.x, layer.mRect.y + layer.mRect.w - static_cast<int>(mProjectionSize.y),
+					static_cast<int>(mProjectionSize.x), static_cast<int>(mProjectionSize.y));
+				if(layer.mFull) {
+					glDisable(GL_SCISSOR_TEST);
+					glClear(GL_COLOR_BUFFER_BIT);
+					layer.mBatch.end();
+					mLayerStats.fullRenders++;
+				} else if(rect.x < rect.z && rect.y < rect.w) {
+					glEnable(GL_SCISSOR_TEST);
+					glScissor(static_cast<int>(rect.x) - layer.mRect.x, layer.mRect.y + layer.mRect.w - static_cast<int>(rect.w),
+						static_cast<int>(rect.z - rect.x), static_cast<int>(rect.w - rect.y));
+					glClear(GL_COLOR_BUFFER_BIT);
+					layer.mBatch.redraw();
+					mLayerStats.partialRenders++;
+				}
+				if(layer.mParent) layer.mParent->mLayer->_addDirty(rect);
+				layer.mFull = false;
+				layer.mDirty = glm::vec4(1e30f, 1e30f, -1e30f, -1e30f);
+			}
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			glBlendFuncSeparate(blend[0], blend[1], blend[2], blend[3]);
+			glClearColor(clear[0], clear[1], clear[2], clear[3]);
+			if(!blending) glDisable(GL_BLEND);
+			if(scissor) glEnable(GL_SCISSOR_TEST);
+			else glDisable(GL_SCISSOR_TEST);
+		}
+		//Marks node for measuring and the path to its layout root for laying out.
+		void _markLayout(CanvasNode* tNode) {
+			for(CanvasNode* node = tNode; node && node->mHasLayout; node = node->mParent) {
+				//Path above is marked already.
+				if(node != tNode && node->mMeasureDirty && node->mLayoutDirty) break;
+				node->mMeasureDirty = node->mLayoutDirty = true;
+			}
+		}
+		void _findLayoutRoots(CanvasNode* tNode) {
+			if(tNode->mHasLayout && !(tNode->mParent && tNode->mParent->mHasLayout)) mLayoutRoots.push_back(tNode);
+			for(auto& child : tNode->mChildren) _findLayoutRoots(child.get());
+		}
+		static bool _inFlow(const CanvasNode* tNode) { return tNode->mHasLayout && tNode->mVisible && !tNode->mStyle.anchored; }
+		//Size the node wants (fixed, or of its content), cached until something below changes.
+		glm::vec2 _measure(CanvasNode* tNode) {
+			if(!tNode->mMeasureDirty) return tNode->mMeasured;
+			mLayoutVisits++;
+			const LayoutStyle& s = tNode->mStyle;
+			int main = s.direction == LD_ROW ? 0 : 1, cross = 1 - main;
+			glm::vec2 content(0);
+			size_t count = 0;
+			for(auto& child : tNode->mChildren) {
+				CanvasNode* c = child.get();
+				if(!_inFlow(c)) continue;
+				glm::vec2 size = _measure(c);
+				//Sizes relative to this node can't make it grow.
+				for(int axis = 0; axis < 2; axis++)
+					if(c->mStyle.percent[axis] >= 0) size[axis] = 0;
+				content[main] += size[main];
+				content[cross] = std::max(content[cross], size[cross]);
+				count++;
+			}
+			if(count > 1) content[main] += s.gap * (count - 1);
+			if(count == 0) {
+				if(tNode->mType == CNT_TEXT)
+					content = glm::vec2(tNode->mFont->measure(tNode->mText, tNode->mScale.x), tNode->mFont->getLineHeight() * tNode->mScale.y);
+				else if(tNode->mType == CNT_ELEMENT) content = tNode->mIntrinsic;
+			}
+			content += glm::vec2(s.padding.x + s.padding.z, s.padding.y + s.padding.w);
+			glm::vec2 size;
+			for(int axis = 0; axis < 2; axis++)
+				size[axis] = glm::clamp(s.size[axis] >= 0 ? s.size[axis] : content[axis], s.minSize[axis], s.maxSize[axis]);
+			tNode->mMeasured = size;
+			tNode->mMeasureDirty = false;
+			return size;
+		}
+		//Measured size with parts relative to the parent's content box resolved.
+		glm::vec2 _sizeIn(CanvasNode* tNode, const glm::vec2 tParent) {
+			glm::vec2 size = _measure(tNode);
+			const LayoutStyle& s = tNode->mStyle;
+			for(int axis = 0; axis < 2; axis++)
+				if(s.percent[axis] >= 0) size[axis] = glm::clamp(s.percent[axis] * tParent[axis], s.minSize[axis], s.maxSize[axis]);
+			return size;
+		}
+		//Places node into box and lays out its children. Skips subtrees that didn't move and have nothing dirty.
+		void _arrange(CanvasNode* tNode, const glm::vec4 tBox, const bool tForce) {
+			bool moved = tBox != tNode->mBox;
+			if(!moved && !tNode->mLayoutDirty && !tForce) return;
+			mLayoutVisits++;
+			tNode->mBox = tBox;
+			tNode->mLayoutDirty = false;
+			if(moved || tForce) _applyBox(tNode);
+			const LayoutStyle& s = tNode->mStyle;
+			int main = s.direction == LD_ROW ? 0 : 1, cross = 1 - main;
+			glm::vec2 origin(tBox.x + s.padding.x, tBox.y + s.padding.y);
+			glm::vec2 inner = glm::max(glm::vec2(tBox.z - s.padding.x - s.padding.z, tBox.w - s.padding.y - s.padding.w), glm::vec2(0));
+			//Free (or missing) space along direction is shared by grow (or shrink weighted by size).
+			float used = 0, grow = 0, shrink = 0;
+			size_t count = 0;
+			for(auto& child : tNode->mChildren) {
+				CanvasNode* c = child.get();
+				if(!_inFlow(c)) continue;
+				float basis = _sizeIn(c, inner)[main];
+				used += basis;
+				grow += c->mStyle.grow;
+				shrink += c->mStyle.shrink * basis;
+				count++;
+			}
+			if(count > 1) used += s.gap * (count - 1);
+			float free = inner[main] - used, pen = origin[main];
+			if(free > 0 && grow == 0) pen += s.justify == LA_CENTER ? free / 2 : s.justify == LA_END ? free : 0;
+			for(auto& child : tNode->mChildren) {
+				CanvasNode* c = child.get();
+				if(!c->mHasLayout || !c->mVisible) continue;
+				const LayoutStyle& cs = c->mStyle;
+				glm::vec2 size = _sizeIn(c, inner), position;
+				if(cs.anchored) position = origin + inner * cs.anchor - size * cs.pivot + cs.offset;
+				else {
+					float basis = size[main];
+					if(free > 0 && grow > 0) size[main] += free * cs.grow / grow;
+					else if(free < 0 && shrink > 0) size[main] += free * cs.shrink * basis / shrink;
+					size[main] = glm::clamp(size[main], cs.minSize[main], cs.maxSize[main]);
+					if(s.align == LA_STRETCH && cs.size[cross] < 0 && cs.percent[cross] < 0)
+						size[cross] = glm::clamp(inner[cross], cs.minSize[cross], cs.maxSize[cross]);
+					position[main] = pen;
+					pen += size[main] + s.gap;
+					float space = inner[cross] - size[cross];
+					position[cross] = origin[cross] + (s.align == LA_CENTER ? space / 2 : s.align == LA_END ? space : 0);
+				}
+				_arrange(c, glm::vec4(position, size), tForce);
+			}
+		}
+		//Moves element or text of the node into its box.
+		void _applyBox(CanvasNode* tNode) {
+			const glm::vec4& box = tNode->mBox;
+			if(tNode->mElement) {
+				UIElement* element = tNode->mElement;
+				element->setPositon(glm::vec3(box.x, mLayoutSize.y - box.y, element->getZIndex()));
+				element->setSize(glm::vec2(box.z, box.w));
+			} else if(tNode->mType == CNT_TEXT) {
+				//Text is placed by baseline.
+				const glm::vec4& padding = tNode->mStyle.padding;
+				float baseline = box.y + padding.y + tNode->mFont->getAscent() * tNode->mScale.y;
+				setPosition(tNode, glm::vec3(box.x + padding.x, mLayoutSize.y - baseline, tNode->mPosition.z));
+			}
+		}
+		static bool _visible(const CanvasNode* tNode) {
+			for(; tNode; tNode = tNode->mParent)
+				if(!tNode->mVisible) return false;
+			return true;
+		}
+
+		std::unique_ptr<CanvasNode> mRoot;
+		UIInput mInput;
+		SpriteBatch mBatch;
+		SpriteBatch mScratch;		// Never initialized, only collects sprites of patched nodes.
+		glm::vec2 mProjectionSize{0};
+		std::unordered_map<UIElement*, CanvasNode*> mElements;
+		std::unordered_map<Text*, unsigned int> mFonts;		// Fonts used by last recording and their generation.
+		std::vector<CanvasNode*> mDirty;
+		std::vector<CanvasNode*> mLayers;		// Cached by last recording, inner ones first.
+		std::vector<CanvasNode*> mLayoutRoots;	// Layout nodes without layout parent.
+		bool mLayoutRootsDirty = false;
+		glm::vec2 mLayoutSize{0};
+		size_t mLayoutVisits = 0;
+		size_t mLayerBudget = 64 * 1024 * 1024;
+		CanvasLayerStats mLayerStats;
+		std::vector<UIElement*> mHovered;
+		bool mStructureDirty = true;
+		size_t mNodeCount = 0, mRebuilds = 0, mPatches = 0, mIdleFrames = 0;
+	};
+}
+
+#endif // !FS_UI_CANVAS
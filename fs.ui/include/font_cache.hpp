@@ -0,0 +1,255 @@
+#ifndef FS_UI_FONT_CACHE
+#define FS_UI_FONT_CACHE
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#ifdef _WIN32
+//Keeps min/max macros (and the rest of Win32) out of code including this header.
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define FS_UI_UNDEF_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#define FS_UI_UNDEF_NOMINMAX
+#endif
+#include <windows.h>
+#ifdef FS_UI_UNDEF_LEAN_AND_MEAN
+#undef WIN32_LEAN_AND_MEAN
+#undef FS_UI_UNDEF_LEAN_AND_MEAN
+#endif
+#ifdef FS_UI_UNDEF_NOMINMAX
+#undef NOMINMAX
+#undef FS_UI_UNDEF_NOMINMAX
+#endif
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../../../engine/include/common.hpp"
+#include "glyph_cache.hpp"
+
+namespace Firesteel {
+	//Read-only memory mapping of a whole file.
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		~MappedFile() { close(); }
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const std::string& tPath) {
+			close();
+#ifdef _WIN32
+			mFile = CreateFileA(tPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if(mFile == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER size;
+			if(!GetFileSizeEx(mFile, &size) || size.QuadPart == 0) { close(); return false; }
+			mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if(!mMapping) { close(); return false; }
+			mData = static_cast<const unsigned char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+			mSize = static_cast<size_t>(size.QuadPart);
+#else
+			mFile = ::open(tPath.c_str(), O_RDONLY);
+			if(mFile < 0) return false;
+			struct stat info;
+			if(fstat(mFile, &info) != 0 || info.st_size == 0) { close(); return false; }
+			void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, mFile, 0);
+			mData = data == MAP_FAILED ? nullptr : static_cast<const unsigned char*>(data);
+			mSize = static_cast<size_t>(info.st_size);
+#endif
+			if(!mData) { close(); return false; }
+			return true;
+		}
+		void close() {
+#ifdef _WIN32
+			if(mData) UnmapViewOfFile(mData);
+			if(mMapping) CloseHandle(mMapping);
+			if(mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+			mMapping = nullptr;
+			mFile = INVALID_HANDLE_VALUE;
+#else
+			if(mData) munmap(const_cast<unsigned char*>(mData), mSize);
+			if(mFile >= 0) ::close(mFile);
+			mFile = -1;
+#endif
+			mData = nullptr;
+			mSize = 0;
+		}
+
+		const unsigned char* data() const { return mData; }
+		size_t size() const { return mSize; }
+	private:
+		const unsigned char* mData = nullptr;
+		size_t mSize = 0;
+#ifdef _WIN32
+		HANDLE mFile = INVALID_HANDLE_VALUE;
+		HANDLE mMapping = nullptr;
+#else
+		int mFile = -1;
+#endif
+	};
+
+	//What baked font depends on.
+	struct FontCacheKey {
+		uint64_t fontHash = 0;		// Of font file contents.
+		int32_t height = 0;
+		uint32_t glyphs = 0;		// Size of preloaded range.
+		uint32_t mode = 0;			// TextRenderMode.
+		int32_t spread = 0;
+	};
+
+	//Baked font atlases (pixels and glyph metrics) stored on disk, so later loads skip FreeType.
+	//Files are named by key hash and checked against the whole key when read.
+	class FontCache {
+	public:
+		//Empty directory (default) turns the cache off.
+		static void setDirectory(const std::string& tDirectory) { _directory() = tDirectory; }
+		static const std::string& getDirectory() { return _directory(); }
+		static bool isEnabled() { return !_directory().empty(); }
+
+		//Hashes file contents. Returns 0 if file can't be read.
+		static uint64_t hashFile(const std::string& tPath) {
+			MappedFile file;
+			if(!file.open(tPath)) return 0;
+			//FNV-1a over 8 byte words, a few times faster than bytewise on big CJK fonts.
+			uint64_t hash = 14695981039346656037ull;
+			const unsigned char* data = file.data();
+			size_t size = file.size(), i = 0;
+			for(; i + 8 <= size; i += 8) {
+				uint64_t word;
+				memcpy(&word, data + i, 8);
+				hash = (hash ^ word) * 1099511628211ull;
+			}
+			for(; i < size; i++) hash = (hash ^ data[i]) * 1099511628211ull;
+			hash = (hash ^ size) * 1099511628211ull;
+			return hash ? hash : 1;
+		}
+
+		//Maps cached font if there is one for the key. Metrics and kerning are copied out,
+		//pixels (side x side, single channel) stay in the mapping.
+		static bool load(const FontCacheKey& tKey, MappedFile& tFile, std::vector<Character>& tGlyphs,
+			std::vector<KerningPair>& tKerning, const unsigned char*& tPixels, int& tSide) {
+			if(!isEnabled() || !tKey.fontHash) return false;
+			if(!tFile.open(_path(tKey))) return false;
+			Header header;
+			if(tFile.size() < sizeof(Header)) { tFile.close(); return false; }
+			memcpy(&header, tFile.data(), sizeof(Header));
+			size_t expected = sizeof(Header) + static_cast<size_t>(header.key.glyphs) * sizeof(Record)
+				+ static_cast<size_t>(header.kerningPairs) * sizeof(KerningPair) + static_cast<size_t>(header.side) * header.side;
+			if(memcmp(header.magic, sMagic, 4) != 0 || header.version != VERSION || !_same(header.key, tKey)
+				|| header.side <= 0 || tFile.size() != expected) {
+				LOG_WARN("Font cache file \"" + _path(tKey) + "\" is stale or broken, font will be baked again.");
+				tFile.close();
+				return false;
+			}
+			tGlyphs.resize(header.key.glyphs);
+			const unsigned char* records = tFile.data() + sizeof(Header);
+			for(size_t i = 0; i < tGlyphs.size(); i++) {
+				Record r;
+				memcpy(&r, records + i * sizeof(Record), sizeof(Record));
+				tGlyphs[i] = Character{
+					glm::ivec2(r.size[0], r.size[1]),
+					glm::ivec2(r.bearing[0], r.bearing[1]),
+					r.advance,
+					glm::vec2(r.uv[0], r.uv[1]),
+					glm::vec2(r.uv[2], r.uv[3]),
+					r.hasPixels
+				};
+			}
+			const unsigned char* kerning = records + tGlyphs.size() * sizeof(Record);
+			tKerning.resize(header.kerningPairs);
+			if(!tKerning.empty()) memcpy(tKerning.data(), kerning, tKerning.size() * sizeof(KerningPair));
+			tPixels = kerning + tKerning.size() * sizeof(KerningPair);
+			tSide = header.side;
+			return true;
+		}
+		//Writes baked font. Character::texture only tells if glyph has pixels.
+		static bool save(const FontCacheKey& tKey, const std::vector<Character>& tGlyphs, const std::vector<KerningPair>& tKerning,
+			const unsigned char* tPixels, const int tSide) {
+			if(!isEnabled() || !tKey.fontHash) return false;
+			std::error_code ec;
+			std::filesystem::create_directories(_directory(), ec);
+			std::string path = _path(tKey);
+			//Written aside and renamed, so nobody maps a half written file.
+			std::string temporary = path + ".tmp";
+			FILE* file = fopen(temporary.c_str(), "wb");
+			if(!file) {
+				LOG_WARN("Couldn't write font cache file \"" + temporary + "\".");
+				return false;
+			}
+			Header header;
+			memcpy(header.magic, sMagic, 4);
+			header.key = tKey;
+			header.key.glyphs = static_cast<uint32_t>(tGlyphs.size());
+			header.side = tSide;
+			header.kerningPairs = static_cast<uint32_t>(tKerning.size());
+			bool ok = fwrite(&header, sizeof(Header), 1, file) == 1;
+			for(size_t i = 0; ok && i < tGlyphs.size(); i++) {
+				const Character& c = tGlyphs[i];
+				Record r{ { c.size.x, c.size.y }, { c.bearing.x, c.bearing.y }, c.advance,
+					{ c.topLeft.x, c.topLeft.y, c.bottomRight.x, c.bottomRight.y }, c.texture ? 1u : 0u };
+				ok = fwrite(&r, sizeof(Record), 1, file) == 1;
+			}
+			if(ok && !tKerning.empty()) ok = fwrite(tKerning.data(), sizeof(KerningPair), tKerning.size(), file) == tKerning.size();
+			size_t pixels = static_cast<size_t>(tSide) * tSide;
+			ok = ok && fwrite(tPixels, 1, pixels, file) == pixels;
+			ok = fclose(file) == 0 && ok;
+			if(ok) {
+				std::filesystem::remove(path, ec);
+				std::filesystem::rename(temporary, path, ec);
+				ok = !ec;
+			}
+			if(!ok) {
+				std::filesystem::remove(temporary, ec);
+				LOG_WARN("Couldn't write font cache file \"" + path + "\".");
+			}
+			return ok;
+		}
+	private:
+		static const uint32_t VERSION = 2;
+		static constexpr const char* sMagic = "FSFC";
+
+		struct Header {
+			char magic[4];
+			uint32_t version = VERSION;
+			FontCacheKey key;
+			int32_t side = 0;
+			uint32_t kerningPairs = 0;
+		};
+		struct Record {
+			int32_t size[2], bearing[2];
+			uint32_t advance;
+			float uv[4];			// Top left and bottom right.
+			uint32_t hasPixels;
+		};
+
+		static std::string& _directory() {
+			static std::string directory;
+			return directory;
+		}
+		static bool _same(const FontCacheKey& tA, const FontCacheKey& tB) {
+			return tA.fontHash == tB.fontHash && tA.height == tB.height && tA.glyphs == tB.glyphs
+				&& tA.mode == tB.mode && tA.spread == tB.spread;
+		}
+		static std::string _path(const FontCacheKey& tKey) {
+			uint64_t hash = tKey.fontHash;
+			for(uint64_t part : { static_cast<uint64_t>(tKey.height), static_cast<uint64_t>(tKey.glyphs),
+				static_cast<uint64_t>(tKey.mode), static_cast<uint64_t>(tKey.spread) })
+				hash = (hash ^ part) * 1099511628211ull;
+			char name[32];
+			snprintf(name, sizeof(name), "%016llx.fsfont", static_cast<unsigned long long>(hash));
+			return (std::filesystem::path(_directory()) / name).string();
+		}
+	};
+}
+
+#endif // !FS_UI_FONT_CACHE
@@ -8,39 +8,30 @@
 #include "../../../engine/include/texture.hpp"
 #include "../../../engine/include/utils/stbi_global.hpp"
 #include "../../../engine/include/input/mouse.hpp"
+#include "batch.hpp"
+#include "texture_cache.hpp"
+#include "atlas.hpp"
 
 namespace Firesteel {
 	class Sprite {
 	public:
-		void initialize(const std::string tSprite = "") {
+		//Sprites with same image share one texture (see TextureCache).
+		//With tAsync sprite draws untextured until TextureCache::pump() uploads the image.
+		void initialize(const std::string tSprite = "", const bool tAsync = false) {
             //Load given texture.
-            if(tSprite != "" && std::filesystem::exists(tSprite)) {
-                mTexture.ID = TextureFromFile(tSprite, &mTexture.isMonochrome, true);
-                mTexture.path = tSprite.c_str();
-                mHasTexture = true;
-            }
-            //Configure VAO and VBO.
-            float vertices[] = {
-            //   X     Y            UV
-                0.0f, 1.0f,     0.0f, 1.0f,
-                1.0f, 0.0f,     1.0f, 0.0f,
-                0.0f, 0.0f,     0.0f, 0.0f,
-
-                0.0f, 1.0f,     0.0f, 1.0f,
-                1.0f, 1.0f,     1.0f, 1.0f,
-                1.0f, 0.0f,     1.0f, 0.0f
-            };
-            //Generate buffers.
-            glGenVertexArrays(1, &mVAO);
-            glGenBuffers(1, &mVBO);
-            glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-            //Put data in new buffers.
-            glBindVertexArray(mVAO);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            glBindVertexArray(0);
+            if(tSprite != "")
+                mTexture = tAsync ? TextureCache::get().loadAsync(tSprite) : TextureCache::get().load(tSprite);
+            //All sprites draw the same quad.
+            if(!mHasQuad) UnitQuad::acquire();
+            mHasQuad = true;
+		}
+		//Takes image from atlas page, so sprites of one page batch together.
+		//Only SpriteBatch knows about sub-rects, shaders passed to draw() get them as "uvRect" uniform.
+		void initialize(TextureAtlas& tAtlas, const std::string tSprite) {
+            mTexture.reset();
+            mRegion = tAtlas.addImage(tSprite);
+            if(!mHasQuad) UnitQuad::acquire();
+            mHasQuad = true;
 		}
 
 		void draw(const Shader* tShader,
@@ -54,7 +45,7 @@ namespace Firesteel {
             model = glm::scale(model, glm::vec3(tSize, 1.f));
             //Update params.
             tShader->enable();
-            tShader->setBool("hasTexture", mHasTexture);
+            tShader->setBool("hasTexture", hasTexture());
             tShader->setBool("isFont", false);
             tShader->setMat4("model", model);
             //TODO: Fix stupid matrix not working correctly.
@@ -62,27 +53,52 @@ namespace Firesteel {
 			//If I change them it just refuses to draw.
             tShader->setMat4("projection", glm::ortho(0.f, tProjectionSize.x, tProjectionSize.y, 0.f));
             tShader->setVec4("color", tColor);
+            //Whole texture unless it's an atlas region (uniform stays set for the next sprite otherwise).
+            tShader->setVec4("uvRect", mRegion.isValid() ? mRegion.uv : glm::vec4(0, 0, 1, 1));
             //Draw.
-            if(mHasTexture) mTexture.enable();
-            glBindVertexArray(mVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glBindVertexArray(0);
+            if(mRegion.isValid()) {
+                glBindTexture(GL_TEXTURE_2D, mRegion.texture);
+            }
+            else if(hasTexture()) mTexture->texture.enable();
+            UnitQuad::draw();
+		}
+		//Queues sprite into batch instead of drawing it right away.
+		void draw(SpriteBatch& tBatch, glm::vec3 tPosition=glm::vec3(0), glm::vec2 tSize=glm::vec2(1), float tPitchRotation=0,
+			glm::vec4 tColor=glm::vec4(1)) const {
+            if(mRegion.isValid()) tBatch.draw(mRegion.texture, tPosition, tSize, tPitchRotation, tColor, mRegion.uv);
+            else tBatch.draw(hasTexture() ? mTexture->texture.ID : 0, tPosition, tSize, tPitchRotation, tColor);
 		}
 
         void remove() {
-            glDeleteVertexArrays(1, &mVAO);
-            glDeleteBuffers(1, &mVBO);
-            if(mHasTexture) mTexture.remove();
-            mHasTexture = false;
+            if(mHasQuad) UnitQuad::release();
+            mHasQuad = false;
+            mTexture.reset();
+            mRegion = AtlasRegion();
         }
+
+        bool hasTexture() const { return mRegion.isValid() || (mTexture && mTexture->ready); }
+        const TextureHandle& getTexture() const { return mTexture; }
+        const AtlasRegion& getRegion() const { return mRegion; }
 	private:
-		unsigned int mVAO = 0, mVBO = 0;
-        bool mHasTexture = false;
-        Texture mTexture;
+        bool mHasQuad = false;
+        TextureHandle mTexture;
+        AtlasRegion mRegion;
 	};
 
+    class UIElement;
+    //Gets told when element's bounds change or element goes away (see UIInput).
+    class UIElementObserver {
+    public:
+        virtual void onElementChanged(UIElement* tElement) = 0;
+        virtual void onElementRemoved(UIElement* tElement) = 0;
+    protected:
+        ~UIElementObserver() = default;
+    };
+
     class UIElement {
+        friend class UIInput;
     public:
+        virtual ~UIElement() { if(mObserver) mObserver->onElementRemoved(this); }
         virtual void onHover() {}
         virtual void onClick() {}
 
@@ -91,45 +107,67 @@ namespace Firesteel {
             mSize = tSize;
             mPitch = tPitch;
             mSprite.initialize(tSprite);
+            _changed();
+        }
+        void initialize(TextureAtlas& tAtlas, const std::string tSprite, const glm::vec2 tPosition = glm::vec2(0), const glm::vec2 tSize = glm::vec2(1), const float tPitch = 0) {
+            mPos = tPosition;
+            mSize = tSize;
+            mPitch = tPitch;
+            mSprite.initialize(tAtlas, tSprite);
+            _changed();
         }
 
+        //Tests and dispatches this element alone. For many elements use UIInput.
         void update(const glm::vec2 tProjectionSize) {
-            glm::vec2 curPos = Mouse::getCursorPosition();
+            if(contains(Mouse::getCursorPosition(), tProjectionSize)) {
+                mState=1;
+                onHover();
+                if(Mouse::buttonDown(0)) {
+                    onClick();
+                    mState=2;
+                }
+            } else mState=0;
+        }
+        //Is cursor (window coordinates) over the element.
+        bool contains(glm::vec2 tCursor, const glm::vec2 tProjectionSize) const {
             if(mPitch!=0) {
                 float pitch=-glm::radians(mPitch);
                 glm::vec2 center = mPos+mSize/2.f;
-                glm::vec2 centeredCurPos = curPos-center;
+                glm::vec2 centeredCurPos = tCursor-center;
                 //Rotate mouse coords to account for button rotation
                 glm::vec2 rotatedCurPos = {
                     centeredCurPos.x*glm::cos(pitch)-centeredCurPos.y*glm::sin(pitch),
                     centeredCurPos.x*glm::sin(pitch)+centeredCurPos.y*glm::cos(pitch)
                 };
                 //"Unrotate" mouse position
-                curPos=center+rotatedCurPos;
+                tCursor=center+rotatedCurPos;
             }
-            if(curPos.x>=mPos.x&&curPos.x<=mPos.x+mSize.x&&
-                curPos.y>=(tProjectionSize.y-mPos.y)&&
-                curPos.y<=(tProjectionSize.y-mPos.y)+mSize.y) {
-                mState=1;
-                onHover();
-                if(Mouse::buttonDown(0)) {
-                    onClick();
-                    mState=2;
-                }
-            } else mState=0;
+            return tCursor.x>=mPos.x&&tCursor.x<=mPos.x+mSize.x&&
+                tCursor.y>=(tProjectionSize.y-mPos.y)&&
+                tCursor.y<=(tProjectionSize.y-mPos.y)+mSize.y;
         }
-        void draw(const Shader* tShader, const glm::vec2 tProjectionSize) {
-            glm::vec4 color = background;
-            switch (mState) {
-            case 1:
-                color=hover;
-                break;
-            case 2:
-                color=clicked;
-                break;
+        //Box (min, max in window coordinates) of all cursor positions contains() accepts.
+        glm::vec4 getBounds(const glm::vec2 tProjectionSize) const {
+            glm::vec2 min(mPos.x, tProjectionSize.y-mPos.y), max = min+mSize;
+            if(mPitch==0) return glm::vec4(min, max);
+            //Corners turned back the way contains() unrotates the cursor.
+            float pitch=glm::radians(mPitch), c=glm::cos(pitch), s=glm::sin(pitch);
+            glm::vec2 center = mPos+mSize/2.f;
+            glm::vec4 bounds(1e30f, 1e30f, -1e30f, -1e30f);
+            for(glm::vec2 corner : { min, glm::vec2(max.x, min.y), max, glm::vec2(min.x, max.y) }) {
+                glm::vec2 d = corner-center;
+                glm::vec2 p = center+glm::vec2(d.x*c-d.y*s, d.x*s+d.y*c);
+                bounds = glm::vec4(glm::min(glm::vec2(bounds), p), glm::max(glm::vec2(bounds.z, bounds.w), p));
             }
+            return bounds;
+        }
+        void draw(const Shader* tShader, const glm::vec2 tProjectionSize) {
+            glm::vec4 color = getStateColor();
             mSprite.draw(tShader, tProjectionSize, glm::vec3(mPos,mZIndex), mSize, mPitch, color);
         }
+        void draw(SpriteBatch& tBatch) const {
+            mSprite.draw(tBatch, glm::vec3(mPos,mZIndex), mSize, mPitch, getStateColor());
+        }
         void draw(const Shader* tShader,
             glm::vec2 tProjectionSize, glm::vec3 tPosition, glm::vec2 tSize, float tPitch = 0,
             glm::vec4 tColor = glm::vec4(1)) {
@@ -144,11 +182,28 @@ namespace Firesteel {
         glm::vec3 getPositionWZ() const { return glm::vec3(mPos, mZIndex); }
         float getPitch() const { return mPitch; }
         glm::vec2 getSize() const { return mSize; }
+        //Color for current state (idle, hovered or clicked).
+        glm::vec4 getStateColor() const {
+            switch (mState) {
+            case 1: return hover;
+            case 2: return clicked;
+            default: return background;
+            }
+        }
 
-        void setPositon(glm::vec2 tPos) { mPos = tPos; }
-        void setPositon(glm::vec3 tPos) { mPos = glm::vec2(tPos.x, tPos.y); mZIndex=tPos.z; }
-        void setPitch(float tPitch) { mPitch = tPitch; }
-        void setSize(glm::vec2 tSize) { mSize = tSize; }
+        void setPositon(glm::vec2 tPos) { if(mPos != tPos) { mPos = tPos; _changed(); } }
+        void setPositon(glm::vec3 tPos) {
+            if(mPos == glm::vec2(tPos.x, tPos.y) && mZIndex == tPos.z) return;
+            mPos = glm::vec2(tPos.x, tPos.y);
+            mZIndex=tPos.z;
+            _changed();
+        }
+        void setPitch(float tPitch) { if(mPitch != tPitch) { mPitch = tPitch; _changed(); } }
+        void setSize(glm::vec2 tSize) { if(mSize != tSize) { mSize = tSize; _changed(); } }
+        //Only one observer at a time. Element has to stay at one address while observed.
+        void setObserver(UIElementObserver* tObserver) { mObserver = tObserver; }
+        UIElementObserver* getObserver() const { return mObserver; }
+        float getZIndex() const { return mZIndex; }
 
         glm::vec4 background{glm::vec3(0.25f),1.f},
             hover{glm::vec3(0.3f),1.f},
@@ -159,6 +214,9 @@ namespace Firesteel {
         short mState=0;
 
         Sprite mSprite;
+        UIElementObserver* mObserver = nullptr;
+
+        void _changed() { if(mObserver) mObserver->onElementChanged(this); }
     };
 
     class Button : public UIElement {
@@ -0,0 +1,212 @@
+#ifndef FS_UI_GLYPH_CACHE
+#define FS_UI_GLYPH_CACHE
+
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include "../../../engine/include/common.hpp"
+#include "render.hpp"
+
+namespace Firesteel {
+	typedef struct {
+		glm::ivec2 size;			// Size of character.
+		glm::ivec2 bearing;			// Distance from origin to top left of character.
+		unsigned int advance;		// Distance from origin to next origin (1/64th pixels).
+		glm::vec2 topLeft;			// Location from top left. [0,0]
+		glm::vec2 bottomRight;		// Location from bottom right. [1,1]
+		unsigned int texture;		// Texture glyph lives in (own atlas or shared atlas page).
+	} Character;
+
+	//Adjustment of pen between two code points, in pixels.
+	struct KerningPair {
+		uint32_t left, right;
+		int32_t value;
+	};
+
+	//Glyphs rasterized at runtime (ones outside of range preloaded by Text::loadFont).
+	//Single channel pages are split into shelves of similar height. Pages are added when all are full,
+	//up to the limit. After that slots of least recently used glyphs are reused.
+	class GlyphCache {
+	public:
+		GlyphCache(const int tPageSize = 1024, const size_t tMaxPages = 4)
+			: mPageSize(tPageSize), mMaxPages(tMaxPages ? tMaxPages : 1) { }
+		~GlyphCache() { remove(); }
+		GlyphCache(const GlyphCache&) = delete;
+		GlyphCache& operator=(const GlyphCache&) = delete;
+
+		//Cached glyph or nullptr. Marks glyph as used at given tick.
+		const Character* find(const uint32_t tCode, const uint64_t tTick) {
+			auto it = mEntries.find(tCode);
+			if(it == mEntries.end()) return nullptr;
+			it->second.lastUse = tTick;
+			mLRU.splice(mLRU.end(), mLRU, it->second.order);
+			return &it->second.character;
+		}
+		//Uploads glyph bitmap (8-bit coverage) and stores it with given metrics.
+		//Glyphs used at tPinned tick or later are never evicted (they may be queued for drawing).
+		//Returns nullptr if there is no place left. Sets tEvicted if some glyph lost its slot.
+		const Character* insert(const uint32_t tCode, Character tMetrics, const unsigned char* tBitmap, const int tPitch,
+			const uint64_t tTick, const uint64_t tPinned, bool& tEvicted) {
+			Entry entry;
+			entry.character = tMetrics;
+			entry.character.texture = 0;
+			entry.lastUse = tTick;
+			int w = tMetrics.size.x, h = tMetrics.size.y;
+			if(w > 0 && h > 0) {
+				if(w + 1 > mPageSize || h + 1 > mPageSize) return nullptr;
+				if(!_allocate(w + 1, h + 1, entry.slot) && !_evict(w + 1, h + 1, tPinned, entry.slot, tEvicted)) return nullptr;
+				_upload(entry.slot, tBitmap, w, h, tPitch);
+				Page& page = mPages[entry.slot.page];
+				float size = static_cast<float>(mPageSize);
+				glm::ivec2 position(entry.slot.x, page.shelves[entry.slot.shelf].y);
+				entry.character.texture = page.texture;
+				entry.character.topLeft = glm::vec2(position) / size;
+				entry.character.bottomRight = glm::vec2(position.x + w, position.y + h) / size;
+			}
+			mLRU.push_back(tCode);
+			entry.order = std::prev(mLRU.end());
+			return &(mEntries[tCode] = entry).character;
+		}
+
+		void remove() {
+			for(Page& page : mPages) glDeleteTextures(1, &page.texture);
+			UIRender::trackDeleted(mPages.size());
+			mPages.clear();
+			mEntries.clear();
+			mLRU.clear();
+		}
+
+		size_t getGlyphCount() const { return mEntries.size(); }
+		size_t getEvictions() const { return mEvictions; }
+		size_t getPageCount() const { return mPages.size(); }
+		unsigned int getPageTexture(const size_t tPage) const { return tPage < mPages.size() ? mPages[tPage].texture : 0; }
+	private:
+		struct Span {
+			int x, width;
+		};
+		struct Shelf {
+			int y, height;
+			int end = 0;				// Where never used part of the shelf starts.
+			std::vector<Span> free;		// Holes left by evicted glyphs.
+		};
+		struct Page {
+			unsigned int texture;
+			int end;					// Where never used part of the page starts.
+			std::vector<Shelf> shelves;
+		};
+		struct Slot {
+			int page = -1, shelf = 0, x = 0, width = 0;
+		};
+		struct Entry {
+			Character character;
+			Slot slot;
+			uint64_t lastUse = 0;
+			std::list<uint32_t>::iterator order;
+		};
+
+		//Shelf can take glyphs a bit lower than itself, so similar glyphs share it without wasting much.
+		static bool _fits(const Shelf& tShelf, const int tHeight) {
+			return tShelf.height >= tHeight && tShelf.height <= tHeight + tHeight / 4 + 2;
+		}
+		bool _take(const size_t tPage, const size_t tShelf, const int tWidth, Slot& tSlot) {
+			Shelf& shelf = mPages[tPage].shelves[tShelf];
+			for(size_t i = 0; i < shelf.free.size(); i++) {
+				Span& span = shelf.free[i];
+				if(span.width < tWidth) continue;
+				tSlot = { static_cast<int>(tPage), static_cast<int>(tShelf), span.x, tWidth };
+				span.x += tWidth;
+				span.width -= tWidth;
+				if(span.width == 0) shelf.free.erase(shelf.free.begin() + i);
+				return true;
+			}
+			if(shelf.end + tWidth > mPageSize) return false;
+			tSlot = { static_cast<int>(tPage), static_cast<int>(tShelf), shelf.end, tWidth };
+			shelf.end += tWidth;
+			return true;
+		}
+		bool _allocate(const int tWidth, const int tHeight, Slot& tSlot) {
+			for(size_t p = 0; p < mPages.size(); p++)
+				for(size_t s = 0; s < mPages[p].shelves.size(); s++)
+					if(_fits(mPages[p].shelves[s], tHeight) && _take(p, s, tWidth, tSlot)) return true;
+			//Open a new shelf, on a new page if needed.
+			size_t page = 0;
+			for(; page < mPages.size(); page++)
+				if(mPages[page].end + tHeight <= mPageSize) break;
+			if(page == mPages.size()) {
+				if(mPages.size() >= mMaxPages) return false;
+				_addPage();
+			}
+			Page& p = mPages[page];
+			p.shelves.push_back(Shelf{ p.end, tHeight, 0, {} });
+			p.end += tHeight;
+			return _take(page, p.shelves.size() - 1, tWidth, tSlot);
+		}
+		//Frees slots of least recently used glyphs (in shelves of fitting height) until one has place for the new glyph.
+		bool _evict(const int tWidth, const int tHeight, const uint64_t tPinned, Slot& tSlot, bool& tEvicted) {
+			for(auto it = mLRU.begin(); it != mLRU.end();) {
+				auto entry = mEntries.find(*it);
+				const Slot slot = entry->second.slot;
+				if(entry->second.lastUse >= tPinned) break;
+				if(slot.page < 0 || !_fits(mPages[slot.page].shelves[slot.shelf], tHeight)) { it++; continue; }
+				it = mLRU.erase(it);
+				mEntries.erase(entry);
+				mEvictions++;
+				tEvicted = true;
+				_release(slot);
+				if(_take(slot.page, slot.shelf, tWidth, tSlot)) return true;
+			}
+			return false;
+		}
+		void _release(const Slot& tSlot) {
+			std::vector<Span>& free = mPages[tSlot.page].shelves[tSlot.shelf].free;
+			Span span{ tSlot.x, tSlot.width };
+			//Merge with neighbouring holes.
+			for(size_t i = 0; i < free.size();) {
+				if(free[i].x + free[i].width == span.x) { span.x = free[i].x; span.width += free[i].width; }
+				else if(span.x + span.width == free[i].x) span.width += free[i].width;
+				else { i++; continue; }
+				free.erase(free.begin() + i);
+			}
+			free.push_back(span);
+		}
+		//Writes glyph with blank padding on the right and bottom, so filtering never picks up evicted glyphs.
+		void _upload(const Slot& tSlot, const unsigned char* tBitmap, const int tWidth, const int tHeight, const int tPitch) {
+			mScratch.assign(static_cast<size_t>(tWidth + 1) * (tHeight + 1), 0);
+			for(int y = 0; y < tHeight; y++)
+				for(int x = 0; x < tWidth; x++)
+					mScratch[static_cast<size_t>(y) * (tWidth + 1) + x] = tBitmap[y * tPitch + x];
+			const Page& page = mPages[tSlot.page];
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTextureSubImage2D(page.texture, 0, tSlot.x, page.shelves[tSlot.shelf].y, tWidth + 1, tHeight + 1,
+				GL_RED, GL_UNSIGNED_BYTE, mScratch.data());
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		}
+		void _addPage() {
+			Page page{ 0, 0, {} };
+			glGenTextures(1, &page.texture);
+			glBindTexture(GL_TEXTURE_2D, page.texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, mPageSize, mPageSize, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+			unsigned char clear = 0;
+			glClearTexImage(page.texture, 0, GL_RED, GL_UNSIGNED_BYTE, &clear);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			UIRender::trackCreated();
+			mPages.push_back(page);
+		}
+
+		int mPageSize;
+		size_t mMaxPages, mEvictions = 0;
+		std::vector<Page> mPages;
+		std::unordered_map<uint32_t, Entry> mEntries;
+		std::list<uint32_t> mLRU;		// Least recently used first.
+		std::vector<unsigned char> mScratch;
+	};
+}
+
+#endif // !FS_UI_GLYPH_CACHE
@@ -0,0 +1,183 @@
+#ifndef FS_UI_INPUT
+#define FS_UI_INPUT
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "../../../engine/include/input/mouse.hpp"
+#include "generic.hpp"
+
+namespace Firesteel {
+	//Mouse state, read once per frame.
+	struct MouseSnapshot {
+		glm::vec2 position{0};
+		bool down = false;		// Left button.
+	};
+
+	//Hover and click handling for many elements.
+	//Elements are kept in a uniform grid (by box of their possible hit area) and moved between cells
+	//only when setPositon()/setSize()/setPitch() change them. A frame reads the mouse once,
+	//tests precisely only elements of the cursor's cell and dispatches onHover()/onClick() to the hit ones,
+	//highest Z first.
+	class UIInput : public UIElementObserver {
+	public:
+		UIInput(const float tCellSize = 64) : mCellSize(tCellSize > 1 ? tCellSize : 1) { }
+		~UIInput() { clear(); }
+		UIInput(const UIInput&) = delete;
+		UIInput& operator=(const UIInput&) = delete;
+
+		//Element becomes observed by this input (replacing previous observer).
+		void add(UIElement* tElement) {
+			if(!tElement || mEntries.count(tElement)) return;
+			tElement->setObserver(this);
+			mEntries[tElement] = Entry();
+			_insert(tElement);
+		}
+		void remove(UIElement* tElement) {
+			auto it = mEntries.find(tElement);
+			if(it == mEntries.end()) return;
+			_erase(tElement, it->second);
+			mEntries.erase(it);
+			_forget(tElement);
+			if(tElement->getObserver() == this) tElement->setObserver(nullptr);
+		}
+		void clear() {
+			for(auto& entry : mEntries)
+				if(entry.first->getObserver() == this) entry.first->setObserver(nullptr);
+			mEntries.clear();
+			mCells.clear();
+			mLarge.clear();
+			mHovered.clear();
+		}
+
+		//Reads mouse and updates states of elements. Call once per frame.
+		void update(const glm::vec2 tProjectionSize) {
+			mMouse.position = Mouse::getCursorPosition();
+			mMouse.down = Mouse::buttonDown(0);
+			//Hit areas depend on window height (elements are placed from the bottom).
+			if(tProjectionSize != mProjectionSize) {
+				mProjectionSize = tProjectionSize;
+				mCells.clear();
+				mLarge.clear();
+				for(auto& entry : mEntries) _insert(entry.first);
+			}
+			mHits.clear();
+			mTested = 0;
+			auto cell = mCells.find(_key(_cell(mMouse.position.x), _cell(mMouse.position.y)));
+			if(cell != mCells.end()) _test(cell->second);
+			_test(mLarge);
+			std::stable_sort(mHits.begin(), mHits.end(), [](const UIElement* tA, const UIElement* tB) {
+				return tA->mZIndex > tB->mZIndex;
+			});
+			//Elements that were under the cursor last frame and aren't now.
+			for(UIElement* element : mHovered)
+				if(std::find(mHits.begin(), mHits.end(), element) == mHits.end()) element->mState = 0;
+			mHovered = mHits;
+			//Handlers may add or remove elements (even destroy them), so a copy is walked
+			//and each element is checked to still be here before it's touched.
+			mDispatch = mHits;
+			for(UIElement* element : mDispatch) {
+				if(!mEntries.count(element)) continue;
+				element->mState = 1;
+				element->onHover();
+				if(!mMouse.down || !mEntries.count(element)) continue;
+				element->onClick();
+				if(mEntries.count(element)) element->mState = 2;
+			}
+		}
+
+		const MouseSnapshot& getMouse() const { return mMouse; }
+		//Elements under the cursor since last update(), highest Z first.
+		const std::vector<UIElement*>& getHovered() const { return mHovered; }
+		size_t getElementCount() const { return mEntries.size(); }
+		//Elements tested precisely by last update().
+		size_t getTestedCount() const { return mTested; }
+
+		void onElementChanged(UIElement* tElement) override {
+			auto it = mEntries.find(tElement);
+			if(it == mEntries.end()) return;
+			_erase(tElement, it->second);
+			_insert(tElement);
+		}
+		void onElementRemoved(UIElement* tElement) override {
+			auto it = mEntries.find(tElement);
+			if(it == mEntries.end()) return;
+			_erase(tElement, it->second);
+			mEntries.erase(it);
+			_forget(tElement);
+		}
+	private:
+		//Elements covering more cells than this are tested every frame instead.
+		static const int LARGE_CELLS = 64;
+
+		struct Entry {
+			glm::ivec4 cells{0, 0, -1, -1};		// First and last cell, inclusive.
+			bool large = false;
+		};
+
+		int _cell(const float tCoordinate) const { return static_cast<int>(std::floor(tCoordinate / mCellSize)); }
+		static int64_t _key(const int tX, const int tY) {
+			return static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(tX)) << 32) | static_cast<uint32_t>(tY));
+		}
+
+		void _insert(UIElement* tElement) {
+			Entry& entry = mEntries[tElement];
+			glm::vec4 bounds = tElement->getBounds(mProjectionSize);
+			entry.cells = glm::ivec4(_cell(bounds.x), _cell(bounds.y), _cell(bounds.z), _cell(bounds.w));
+			int64_t count = static_cast<int64_t>(entry.cells.z - entry.cells.x + 1) * (entry.cells.w - entry.cells.y + 1);
+			entry.large = count > LARGE_CELLS;
+			if(entry.large) {
+				mLarge.push_back(tElement);
+				return;
+			}
+			for(int y = entry.cells.y; y <= entry.cells.w; y++)
+				for(int x = entry.cells.x; x <= entry.cells.z; x++)
+					mCells[_key(x, y)].push_back(tElement);
+		}
+		void _erase(UIElement* tElement, const Entry& tEntry) {
+			if(tEntry.large) {
+				_unlist(mLarge, tElement);
+				return;
+			}
+			for(int y = tEntry.cells.y; y <= tEntry.cells.w; y++)
+				for(int x = tEntry.cells.x; x <= tEntry.cells.z; x++) {
+					auto cell = mCells.find(_key(x, y));
+					if(cell == mCells.end()) continue;
+					_unlist(cell->second, tElement);
+					if(cell->second.empty()) mCells.erase(cell);
+				}
+		}
+		static void _unlist(std::vector<UIElement*>& tList, UIElement* tElement) {
+			auto it = std::find(tList.begin(), tList.end(), tElement);
+			if(it == tList.end()) return;
+			*it = tList.back();
+			tList.pop_back();
+		}
+		void _forget(UIElement* tElement) {
+			//Hovered elements keep their Z order.
+			mHovered.erase(std::remove(mHovered.begin(), mHovered.end(), tElement), mHovered.end());
+			_unlist(mHits, tElement);
+		}
+		void _test(const std::vector<UIElement*>& tCandidates) {
+			for(UIElement* element : tCandidates) {
+				mTested++;
+				if(element->contains(mMouse.position, mProjectionSize)) mHits.push_back(element);
+			}
+		}
+
+		float mCellSize;
+		glm::vec2 mProjectionSize{0};
+		MouseSnapshot mMouse;
+		std::unordered_map<UIElement*, Entry> mEntries;
+		std::unordered_map<int64_t, std::vector<UIElement*>> mCells;
+		std::vector<UIElement*> mLarge;
+		std::vector<UIElement*> mHits, mHovered, mDispatch;
+		size_t mTested = 0;
+	};
+}
+
+#endif // !FS_UI_INPUT
@@ -0,0 +1,47 @@
+#ifndef FS_UI_LAYOUT
+#define FS_UI_LAYOUT
+
+#include <glm/glm.hpp>
+
+namespace Firesteel {
+	//How children of a layout node are placed.
+	enum LayoutDirection {
+		LD_COLUMN=0,		// Top to bottom.
+		LD_ROW				// Left to right.
+	};
+	enum LayoutAlign {
+		LA_START=0,
+		LA_CENTER,
+		LA_END,
+		LA_STRETCH			// Fill the line (across direction only).
+	};
+
+	//Layout constraints of a canvas node (see Canvas::setLayout()).
+	//Boxes are in window pixels from top left, so they don't change with window height.
+	struct LayoutStyle {
+		LayoutDirection direction = LD_COLUMN;
+		LayoutAlign justify = LA_START;		// Children along direction (when none of them grows).
+		LayoutAlign align = LA_START;		// Children across direction.
+		glm::vec4 padding{0};				// Left, top, right, bottom.
+		float gap = 0;						// Between children.
+		glm::vec2 size{-1};					// Negative takes size of content.
+		glm::vec2 percent{-1};				// Fraction of parent's content box (window for top nodes), overrides size.
+		glm::vec2 minSize{0}, maxSize{1e30f};
+		float grow = 0, shrink = 1;			// Share of free (or missing) space along parent's direction.
+		//Anchored node is left out of parent's flow: its pivot (fraction of own size)
+		//is put at anchor (fraction of parent's content box) moved by offset.
+		//Top layout nodes (without layout parent) are always anchored to the window.
+		bool anchored = false;
+		glm::vec2 anchor{0}, pivot{0}, offset{0};
+
+		bool operator==(const LayoutStyle& tOther) const {
+			return direction == tOther.direction && justify == tOther.justify && align == tOther.align
+				&& padding == tOther.padding && gap == tOther.gap && size == tOther.size && percent == tOther.percent
+				&& minSize == tOther.minSize && maxSize == tOther.maxSize && grow == tOther.grow && shrink == tOther.shrink
+				&& anchored == tOther.anchored && anchor == tOther.anchor && pivot == tOther.pivot && offset == tOther.offset;
+		}
+		bool operator!=(const LayoutStyle& tOther) const { return !(*this == tOther); }
+	};
+}
+
+#endif // !FS_UI_LAYOUT
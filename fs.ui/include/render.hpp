@@ -0,0 +1,242 @@
+#ifndef FS_UI_RENDER
+#define FS_UI_RENDER
+
+#include <string>
+#include <vector>
+
+#include "../../../engine/include/common.hpp"
+
+namespace Firesteel {
+	//What fs.ui holds on the GPU.
+	struct UIDiagnostics {
+		size_t glObjectsCreated = 0;	// Since start (VAOs, buffers, textures, programs).
+		size_t glObjectsAlive = 0;
+		size_t quadUsers = 0;			// Holders of the shared unit quad.
+		size_t ringStalls = 0;			// Times CPU waited for GPU to free a ring segment.
+	};
+
+	//GL helpers shared by fs.ui renderers.
+	class UIRender {
+		friend class UnitQuad;
+		friend class StreamRing;
+	public:
+		static const UIDiagnostics& getDiagnostics() { return _diagnostics(); }
+		//Every fs.ui renderer reports GL objects it makes and frees.
+		static void trackCreated(const size_t tCount = 1) {
+			_diagnostics().glObjectsCreated += tCount;
+			_diagnostics().glObjectsAlive += tCount;
+		}
+		static void trackDeleted(const size_t tCount = 1) {
+			UIDiagnostics& d = _diagnostics();
+			d.glObjectsAlive = d.glObjectsAlive > tCount ? d.glObjectsAlive - tCount : 0;
+		}
+
+		//Builds program from given GLSL sources. Returns 0 on failure.
+		static unsigned int compileProgram(const char* tVertex, const char* tFragment) {
+			unsigned int vs = _compileStage(GL_VERTEX_SHADER, tVertex);
+			unsigned int fs = _compileStage(GL_FRAGMENT_SHADER, tFragment);
+			if(!vs || !fs) {
+				if(vs) glDeleteShader(vs);
+				if(fs) glDeleteShader(fs);
+				return 0;
+			}
+			unsigned int program = glCreateProgram();
+			glAttachShader(program, vs);
+			glAttachShader(program, fs);
+			glLinkProgram(program);
+			glDeleteShader(vs);
+			glDeleteShader(fs);
+			int ok = 0;
+			glGetProgramiv(program, GL_LINK_STATUS, &ok);
+			if(!ok) {
+				char log[1024];
+				glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+				LOG_ERRR(std::string("Couldn't link UI shader program: ") + log);
+				glDeleteProgram(program);
+				return 0;
+			}
+			trackCreated();
+			return program;
+		}
+	private:
+		static UIDiagnostics& _diagnostics() {
+			static UIDiagnostics diagnostics;
+			return diagnostics;
+		}
+
+		static unsigned int _compileStage(unsigned int tType, const char* tSource) {
+			unsigned int shader = glCreateShader(tType);
+			glShaderSource(shader, 1, &tSource, nullptr);
+			glCompileShader(shader);
+			int ok = 0;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+			if(!ok) {
+				char log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+				LOG_ERRR(std::string("Couldn't compile UI shader: ") + log);
+				glDeleteShader(shader);
+				return 0;
+			}
+			return shader;
+		}
+	};
+
+	//One quad (4 vertices, 6 indices) shared by every sprite and batch.
+	//Created by the first holder and freed by the last one.
+	class UnitQuad {
+	public:
+		static void acquire() {
+			State& s = _state();
+			if(s.users++ > 0) {
+				UIRender::_diagnostics().quadUsers = s.users;
+				return;
+			}
+			float vertices[] = {
+			//   X     Y            UV
+				0.0f, 0.0f,     0.0f, 0.0f,
+				1.0f, 0.0f,     1.0f, 0.0f,
+				1.0f, 1.0f,     1.0f, 1.0f,
+				0.0f, 1.0f,     0.0f, 1.0f
+			};
+			unsigned char indices[] = { 3, 1, 0,  3, 2, 1 };
+			glGenVertexArrays(1, &s.vao);
+			glGenBuffers(1, &s.vbo);
+			glGenBuffers(1, &s.ebo);
+			glBindVertexArray(s.vao);
+			glBindBuffer(GL_ARRAY_BUFFER, s.vbo);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s.ebo);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+			bindAttributes();
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			UIRender::trackCreated(3);
+			UIRender::_diagnostics().quadUsers = s.users;
+		}
+		static void release() {
+			State& s = _state();
+			if(s.users == 0) return;
+			UIRender::_diagnostics().quadUsers = --s.users;
+			if(s.users > 0) return;
+			glDeleteVertexArrays(1, &s.vao);
+			glDeleteBuffers(1, &s.vbo);
+			glDeleteBuffers(1, &s.ebo);
+			s.vao = s.vbo = s.ebo = 0;
+			UIRender::trackDeleted(3);
+		}
+
+		//Binds quad buffers into currently bound VAO (attribute 0: position and UV).
+		static void bindAttributes() {
+			glBindBuffer(GL_ARRAY_BUFFER, _state().vbo);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _state().ebo);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+		}
+		//Draws the quad with its own VAO.
+		static void draw() {
+			glBindVertexArray(_state().vao);
+			glDrawElements(GL_TRIANGLES, INDEX_COUNT, GL_UNSIGNED_BYTE, (void*)0);
+			glBindVertexArray(0);
+		}
+
+		static const int INDEX_COUNT = 6;
+		static const unsigned int INDEX_TYPE = GL_UNSIGNED_BYTE;
+	private:
+		struct State {
+			unsigned int vao = 0, vbo = 0, ebo = 0;
+			size_t users = 0;
+		};
+		static State& _state() {
+			static State state;
+			return state;
+		}
+	};
+
+	//Persistently mapped vertex buffer split into segments (3 by default) used one after another.
+	//CPU writes straight into mapped memory, a fence guards every segment until GPU is done with it,
+	//so writes never wait for orphaning or for the draw that read previous data.
+	class StreamRing {
+	public:
+		~StreamRing() { remove(); }
+
+		bool initialize(const size_t tSegmentSize, const unsigned int tSegments = 3) {
+			remove();
+			mSegmentSize = tSegmentSize;
+			mSegments = tSegments < 2 ? 2 : tSegments;
+			size_t size = mSegmentSize * mSegments;
+			const unsigned int flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glCreateBuffers(1, &mBuffer);
+			glNamedBufferStorage(mBuffer, static_cast<long>(size), nullptr, flags);
+			mData = static_cast<unsigned char*>(glMapNamedBufferRange(mBuffer, 0, static_cast<long>(size), flags));
+			if(!mData) {
+				LOG_ERRR("Couldn't map UI stream buffer.");
+				glDeleteBuffers(1, &mBuffer);
+				mBuffer = 0;
+				return false;
+			}
+			mFences.assign(mSegments, nullptr);
+			mCurrent = 0;
+			mHead = 0;
+			UIRender::trackCreated();
+			return true;
+		}
+		void remove() {
+			if(!mBuffer) return;
+			for(GLsync fence : mFences)
+				if(fence) glDeleteSync(fence);
+			mFences.clear();
+			glUnmapNamedBuffer(mBuffer);
+			glDeleteBuffers(1, &mBuffer);
+			UIRender::trackDeleted();
+			mBuffer = 0;
+			mData = nullptr;
+		}
+
+		//Reserves given amount of bytes in current segment (moving to next one if it's full).
+		//Returns where to write and byte offset of that place in the buffer.
+		//Grows (recreating the buffer) if data doesn't fit into a segment at all.
+		unsigned char* allocate(const size_t tBytes, const size_t tAlign, size_t& tOffset) {
+			if(tBytes > mSegmentSize || !mBuffer) {
+				size_t size = 4096;
+				while(size < tBytes) size *= 2;
+				if(!initialize(size > mSegmentSize ? size : mSegmentSize, mSegments ? mSegments : 3)) return nullptr;
+			}
+			size_t head = (mHead + tAlign - 1) / tAlign * tAlign;
+			if(head + tBytes > mSegmentSize) {
+				_nextSegment();
+				head = 0;
+			}
+			mHead = head + tBytes;
+			tOffset = mCurrent * mSegmentSize + head;
+			return mData + tOffset;
+		}
+
+		unsigned int getBuffer() const { return mBuffer; }
+		size_t getSegmentSize() const { return mSegmentSize; }
+	private:
+		void _nextSegment() {
+			//Draws reading current segment are already issued, fence them.
+			if(mFences[mCurrent]) glDeleteSync(mFences[mCurrent]);
+			mFences[mCurrent] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			mCurrent = (mCurrent + 1) % mSegments;
+			GLsync fence = mFences[mCurrent];
+			if(fence) {
+				if(glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+					UIRender::_diagnostics().ringStalls++;
+					while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) { }
+				}
+				glDeleteSync(fence);
+				mFences[mCurrent] = nullptr;
+			}
+			mHead = 0;
+		}
+
+		unsigned int mBuffer = 0;
+		unsigned char* mData = nullptr;
+		size_t mSegmentSize = 0, mHead = 0;
+		unsigned int mSegments = 0, mCurrent = 0;
+		std::vector<GLsync> mFences;
+	};
+}
+
+#endif // !FS_UI_RENDER
@@ -3,27 +3,46 @@
 
 #include <filesystem>
 #include <string>
-#include <map>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <../external/freetype/ft2build.h>
 #include FT_FREETYPE_H
+#include FT_MODULE_H
 #include <../external/freetype/include/freetype.h>
 
 #include "../../../engine/include/common.hpp"
 #include "../../../engine/include/shader.hpp"
+#include "render.hpp"
+#include "batch.hpp"
+#include "atlas.hpp"
+#include "glyph_cache.hpp"
+#include "font_cache.hpp"
 
 FT_Library gFreeType;
 bool gInit;
-bool gDone;
 
 namespace Firesteel {
-	typedef struct {
-		glm::ivec2 size;			// Size of character.
-		glm::ivec2 bearing;			// Distance from origin to top left of character.
-		unsigned int advance;		// Distance from origin to next origin (1/64th pixels).
-		glm::vec2 topLeft;			// Location from top left. [0,0]
-		glm::vec2 bottomRight;		// Location from bottom right. [1,1]
-	} Character;
+	//Extras of SDF fonts drawn with built-in shader. Sizes are in font pixels (so they scale with text)
+	//and can't go beyond the spread font was loaded with.
+	struct TextEffects {
+		glm::vec4 outlineColor{0};
+		float outlineWidth = 0;
+		glm::vec4 shadowColor{0};
+		glm::vec2 shadowOffset{0};		// Positive Y goes down.
+		float shadowSoftness = 0;
+
+		bool operator==(const TextEffects& tOther) const {
+			return outlineColor == tOther.outlineColor && outlineWidth == tOther.outlineWidth && shadowColor == tOther.shadowColor
+				&& shadowOffset == tOther.shadowOffset && shadowSoftness == tOther.shadowSoftness;
+		}
+	};
 
 	class TextRenderer {
 	public:
@@ -37,6 +56,233 @@ namespace Firesteel {
 		static bool isInitialized() {
 			return gInit;
 		}
+
+		//Text draws between beginBatch() and endBatch() are merged: the ones with same shader,
+		//texture, color and depth go to GPU with one write and become one draw call.
+		static void beginBatch() {
+			State& s = _state();
+			s.batching = true;
+			s.batchStart = s.tick + 1;
+		}
+		static bool isBatching() { return _state().batching; }
+		static void endBatch() {
+			State& s = _state();
+			s.batching = false;
+			size_t floats = 0;
+			for(const Pending& p : s.pending) floats += p.vertices.size();
+			if(floats == 0) return;
+			size_t offset = 0;
+			float* out = _allocate(floats, offset);
+			if(!out) { s.pending.clear(); return; }
+			size_t first = offset / VERTEX_SIZE;
+			for(const Pending& p : s.pending) {
+				memcpy(out, p.vertices.data(), p.vertices.size() * sizeof(float));
+				out += p.vertices.size();
+				size_t count = p.vertices.size() / 4;
+				_setup(p.shader, p.projectionSize, glm::vec3(0, 0, p.z), p.color, p.effects, p.spread);
+				glBindTexture(GL_TEXTURE_2D, p.texture);
+				glDrawArrays(GL_TRIANGLES, static_cast<int>(first), static_cast<int>(count));
+				s.drawCalls++;
+				first += count;
+			}
+			_unbind();
+			s.pending.clear();
+		}
+		//Frees buffers shared by all Text objects and FreeType. Fonts have to be removed before.
+		static void remove() {
+			if(gInit) FT_Done_FreeType(gFreeType);
+			gInit = false;
+			State& s = _state();
+			if(s.vao) {
+				glDeleteVertexArrays(1, &s.vao);
+				UIRender::trackDeleted();
+			}
+			s.vao = 0;
+			s.vaoBuffer = 0;
+			s.ring.remove();
+			if(s.program) {
+				glDeleteProgram(s.program);
+				UIRender::trackDeleted();
+			}
+			s.program = 0;
+		}
+		//Draw calls issued for text since start.
+		static size_t getDrawCalls() { return _state().drawCalls; }
+	private:
+		friend class Text;
+		friend class TextMesh;
+		friend class TextParagraph;
+		static const size_t VERTEX_SIZE = 4 * sizeof(float);
+
+		struct Pending {
+			const Shader* shader;
+			glm::vec2 projectionSize;
+			float z;
+			glm::vec4 color;
+			TextEffects effects;
+			float spread;
+			unsigned int texture;
+			std::vector<float> vertices;
+		};
+		struct State {
+			bool batching = false;
+			std::vector<Pending> pending;
+			StreamRing ring;
+			unsigned int vao = 0, vaoBuffer = 0, program = 0;
+			size_t drawCalls = 0;
+			//Glyph cache clock: advances with every drawn string.
+			uint64_t tick = 0, batchStart = 0;
+		};
+		static State& _state() {
+			static State state;
+			return state;
+		}
+
+		static uint64_t _tick() { return ++_state().tick; }
+		//Glyphs used since this tick may be queued for drawing and can't be evicted.
+		static uint64_t _pinned() {
+			const State& s = _state();
+			return s.batching ? s.batchStart : s.tick;
+		}
+		//Takes place for given amount of floats in the ring and binds VAO reading it.
+		static float* _allocate(const size_t tFloats, size_t& tOffset) {
+			State& s = _state();
+			unsigned char* out = s.ring.allocate(tFloats * sizeof(float), VERTEX_SIZE, tOffset);
+			if(!out) return nullptr;
+			if(!s.vao) {
+				glGenVertexArrays(1, &s.vao);
+				UIRender::trackCreated();
+			}
+			glBindVertexArray(s.vao);
+			//Ring recreates its buffer when it grows.
+			if(s.vaoBuffer != s.ring.getBuffer()) {
+				glBindBuffer(GL_ARRAY_BUFFER, s.ring.getBuffer());
+				glEnableVertexAttribArray(0);
+				glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, VERTEX_SIZE, 0);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+				s.vaoBuffer = s.ring.getBuffer();
+			}
+			return reinterpret_cast<float*>(out);
+		}
+		//Without shader given uses the built-in one (the only one that knows SDF fonts).
+		static void _setup(const Shader* tShader, const glm::vec2 tProjectionSize, const glm::vec3 tOffset, const glm::vec4 tColor,
+			const TextEffects& tEffects = TextEffects(), const float tSpread = 0) {
+			const glm::mat4 projection = glm::ortho(0.f, tProjectionSize.x, 0.f, tProjectionSize.y);
+			const glm::mat4 model = glm::translate(glm::mat4(1), tOffset);
+			glActiveTexture(GL_TEXTURE0);
+			if(tShader) {
+				tShader->enable();
+				tShader->setBool("isFont", true);
+				tShader->setBool("hasTexture", true);
+				tShader->setVec4("color", tColor);
+				tShader->setMat4("projection", projection);
+				tShader->setMat4("model", model);
+				return;
+			}
+			State& s = _state();
+			if(!s.program) s.program = UIRender::compileProgram(sVertex, sFragment);
+			glUseProgram(s.program);
+			glUniformMatrix4fv(glGetUniformLocation(s.program, "projection"), 1, GL_FALSE, &projection[0][0]);
+			glUniformMatrix4fv(glGetUniformLocation(s.program, "model"), 1, GL_FALSE, &model[0][0]);
+			glUniform1i(glGetUniformLocation(s.program, "tex"), 0);
+			glUniform4fv(glGetUniformLocation(s.program, "color"), 1, &tColor[0]);
+			glUniform1f(glGetUniformLocation(s.program, "spread"), tSpread);
+			glUniform4fv(glGetUniformLocation(s.program, "outlineColor"), 1, &tEffects.outlineColor[0]);
+			glUniform1f(glGetUniformLocation(s.program, "outlineWidth"), tEffects.outlineWidth);
+			glUniform4fv(glGetUniformLocation(s.program, "shadowColor"), 1, &tEffects.shadowColor[0]);
+			glUniform2fv(glGetUniformLocation(s.program, "shadowOffset"), 1, &tEffects.shadowOffset[0]);
+			glUniform1f(glGetUniformLocation(s.program, "shadowSoftness"), tEffects.shadowSoftness);
+		}
+		static void _unbind() {
+			glBindVertexArray(0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		//Draws (or queues, when batching) quads of one string, grouped by texture.
+		static void _submit(const Shader* tShader, const glm::vec2 tProjectionSize, const float tZ, const glm::vec4 tColor,
+			const TextEffects& tEffects, const float tSpread, const std::vector<float>& tVertices, const std::vector<std::pair<unsigned int, size_t>>& tRuns) {
+			State& s = _state();
+			if(s.batching) {
+				size_t start = 0;
+				for(const auto& run : tRuns) {
+					Pending* target = nullptr;
+					for(Pending& p : s.pending)
+						if(p.shader == tShader && p.texture == run.first && p.z == tZ && p.color == tColor && p.projectionSize == tProjectionSize
+							&& p.spread == tSpread && p.effects == tEffects) {
+							target = &p;
+							break;
+						}
+					if(!target) {
+						s.pending.push_back({ tShader, tProjectionSize, tZ, tColor, tEffects, tSpread, run.first, {} });
+						target = &s.pending.back();
+					}
+					target->vertices.insert(target->vertices.end(), tVertices.begin() + start, tVertices.begin() + start + run.second * 4);
+					start += run.second * 4;
+				}
+				return;
+			}
+			size_t offset = 0;
+			float* out = _allocate(tVertices.size(), offset);
+			if(!out) return;
+			memcpy(out, tVertices.data(), tVertices.size() * sizeof(float));
+			_setup(tShader, tProjectionSize, glm::vec3(0, 0, tZ), tColor, tEffects, tSpread);
+			size_t first = offset / VERTEX_SIZE;
+			for(const auto& run : tRuns) {
+				glBindTexture(GL_TEXTURE_2D, run.first);
+				glDrawArrays(GL_TRIANGLES, static_cast<int>(first), static_cast<int>(run.second));
+				s.drawCalls++;
+				first += run.second;
+			}
+			_unbind();
+		}
+
+		static constexpr const char* sVertex = R"(#version 330 core
+layout(location = 0) in vec4 aVertex;
+uniform mat4 projection;
+uniform mat4 model;
+out vec2 vUV;
+void main() {
+	gl_Position = projection * model * vec4(aVertex.xy, 0.0, 1.0);
+	vUV = aVertex.zw;
+})";
+		//Spread of 0 means coverage bitmap. Otherwise texel is distance to the edge: 0.5 on it, spread px at 0 and 1.
+		static constexpr const char* sFragment = R"(#version 330 core
+in vec2 vUV;
+uniform sampler2D tex;
+uniform vec4 color;
+uniform float spread;
+uniform vec4 outlineColor;
+uniform float outlineWidth;
+uniform vec4 shadowColor;
+uniform vec2 shadowOffset;
+uniform float shadowSoftness;
+out vec4 fragColor;
+float distanceAt(vec2 uv) {
+	return (texture(tex, uv).r * 255.0 - 128.0) / 128.0 * spread;
+}
+float cover(float d, float w) {
+	return clamp(d / w + 0.5, 0.0, 1.0);
+}
+vec4 over(vec4 top, vec4 bottom) {
+	float a = top.a + bottom.a * (1.0 - top.a);
+	return vec4((top.rgb * top.a + bottom.rgb * bottom.a * (1.0 - top.a)) / max(a, 1e-5), a);
+}
+void main() {
+	if(spread <= 0.0) {
+		fragColor = vec4(color.rgb, color.a * texture(tex, vUV).r);
+		return;
+	}
+	float d = distanceAt(vUV);
+	//Edge is one screen pixel wide at any scale.
+	float w = max(fwidth(d), 1e-4);
+	vec4 result = vec4(color.rgb, color.a * cover(d, w));
+	if(outlineWidth > 0.0)
+		result = over(result, vec4(outlineColor.rgb, outlineColor.a * cover(d + outlineWidth, w)));
+	if(shadowColor.a > 0.0) {
+		float s = distanceAt(vUV - shadowOffset / vec2(textureSize(tex, 0))) + outlineWidth;
+		result = over(result, vec4(shadowColor.rgb, shadowColor.a * cover(s, w + shadowSoftness)));
+	}
+	fragColor = result;
+})";
 	};
 
 	// [!WARNING]
@@ -47,8 +293,86 @@ namespace Firesteel {
 		TGR_ISO8859_5=242
 	};
 
+	enum TextRenderMode {
+		TRM_BITMAP=0,	// Coverage at loaded size.
+		TRM_SDF			// Signed distance field, scales without blur (draw with built-in shader).
+	};
+
+	//Placement of paragraph lines in its width.
+	enum TextAlign {
+		TA_LEFT=0,
+		TA_CENTER,
+		TA_RIGHT
+	};
+
+	class Text;
+	//Pen positions of every character of a string (advances and kerning summed once),
+	//so width, caret and hit queries on long strings are binary searches.
+	//set() can be called each frame: when only the end of string changed (typing) only the changed suffix is measured.
+	class TextMetrics {
+	public:
+		//Returns true if positions were measured again. Font has to outlive metrics.
+		bool set(Text& tFont, const std::string& tText);
+
+		const std::string& getText() const { return mText; }
+		size_t getCharCount() const { return mBytes.empty() ? 0 : mBytes.size() - 1; }
+		//Pen advance of whole string, in pixels.
+		float getWidth(const float tScale = 1) const { return mPens.empty() ? 0 : mPens.back() * tScale; }
+		//Pen position before the character at given byte (string end for bytes past it).
+		float getCaret(const size_t tByte, const float tScale = 1) const {
+			if(mPens.empty()) return 0;
+			size_t c = std::lower_bound(mBytes.begin(), mBytes.end(), tByte) - mBytes.begin();
+			return mPens[c < mPens.size() ? c : mPens.size() - 1] * tScale;
+		}
+		//Byte of the caret position closest to given pen position.
+		size_t hitTest(const float tX, const float tScale = 1) const {
+			if(mPens.empty() || tScale <= 0) return 0;
+			float x = tX / tScale;
+			size_t c = std::lower_bound(mPens.begin(), mPens.end(), x) - mPens.begin();
+			if(c == mPens.size()) return mBytes.back();
+			if(c > 0 && x - mPens[c - 1] < mPens[c] - x) c--;
+			return mBytes[c];
+		}
+		//Bytes of the longest start of string that fits into given width (e.g. to put an ellipsis after it).
+		size_t fit(const float tWidth, const float tScale = 1) const {
+			if(mPens.empty() || tScale <= 0) return 0;
+			size_t c = std::upper_bound(mPens.begin(), mPens.end(), tWidth / tScale) - mPens.begin();
+			return c ? mBytes[c - 1] : 0;
+		}
+	private:
+		friend class TextParagraph;
+		//Measures from given character to the end of mText.
+		void _measure(Text& tFont, size_t tFrom);
+
+		const Text* mFont = nullptr;
+		unsigned int mGeneration = 0;
+		std::string mText;
+		//Where every character starts and where pen stands before it (kerning applied), at loaded size.
+		//Both end with an entry for the end of string.
+		std::vector<size_t> mBytes;
+		std::vector<int> mPens;
+	};
+
 	class Text {
+		friend class TextMesh;
+		friend class TextMetrics;
+		friend class TextParagraph;
 	public:
+		//Puts glyphs of next loadFont() into given atlas instead of own texture,
+		//so text and sprites from the same page can be drawn by one SpriteBatch call.
+		//Atlas has to outlive the font.
+		void setAtlas(TextureAtlas* tAtlas) { mAtlas = tAtlas; }
+		//Render mode of next loadFont(). In SDF mode height given to loadFont() is the reference size:
+		//one atlas serves every size (scale it with draw size) and glyphs get outline and shadow.
+		//Spread is how far (in font pixels) from the edge distance is kept, it limits effect sizes.
+		//SDF glyphs can't go to shared atlas, as SpriteBatch draws coverage only.
+		void setMode(const TextRenderMode tMode, const int tSpread = 8) {
+			mMode = tMode;
+			mSpread = tSpread < 2 ? 2 : tSpread > 32 ? 32 : tSpread;
+		}
+
+		//Glyphs outside of the range given to loadFont() are rasterized when first drawn.
+		//With FontCache enabled baked atlas is stored on disk and reused by next loads of the same font.
 		bool loadFont(const std::string tTTFPath, const int tHeight, const TextGlyphRange tLastCharId=TGR_ASCII) {
 			if(!TextRenderer::isInitialized()) return false;
 			if(!std::filesystem::exists(tTTFPath)) {
@@ -56,172 +380,893 @@ namespace Firesteel {
 				return false;
 			}
 			//Assign variables and load font.
-			mChars.clear();
+			remove();
 			mHeight = tHeight;
-			FT_Face font;
-			if (FT_New_Face(gFreeType, tTTFPath.c_str(), 0, &font)) {
-				LOG_ERRR("Couldn't load font file \"" + tTTFPath + "\".");
-				return false;
+			mPath = tTTFPath;
+			//Font baked before comes from disk, without FreeType.
+			FontCacheKey key;
+			bool cacheable = FontCache::isEnabled() && (!mAtlas || mMode == TRM_SDF);
+			if(cacheable) {
+				key = { FontCache::hashFile(tTTFPath), mHeight, static_cast<uint32_t>(tLastCharId),
+					static_cast<uint32_t>(mMode), mMode == TRM_SDF ? mSpread : 0 };
+				MappedFile file;
+				const unsigned char* pixels = nullptr;
+				int side = 0;
+				std::vector<KerningPair> kerning;
+				if(FontCache::load(key, file, mHot, kerning, pixels, side)) {
+					for(const KerningPair& pair : kerning) mKerning[_pair(pair.left, pair.right)] = pair.value;
+					_upload(pixels, side);
+					return _loaded();
+				}
 			}
-			//Set height and dynamic width.
-			FT_Set_Pixel_Sizes(font, 0, mHeight);
-			//Load texture.
-			//Disables the byte-alignment restriction so can use 1 byte for each pixel.
-			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-			int atlasWidth = 0, atlasHeight = 0;
-			//Load characters of given glyph array.
-			for (unsigned char c = 0; c < tLastCharId; c++) {
-				//Load glyph.
-				if (FT_Load_Char(font, c, FT_LOAD_RENDER)) {
-					LOG_ERRR(std::string("Couldn't load glyph #") + (const char *)(c+1) + ".");
-					continue;
+			if(!_openFace()) return false;
+			_loadKerning(static_cast<uint32_t>(tLastCharId));
+			if(mMode == TRM_SDF && mAtlas) LOG_WARN("SDF font can't use shared atlas, it gets own texture.");
+			_applySpread();
+			//Render every glyph of the range once.
+			std::vector<GlyphBitmap> glyphs;
+			_rasterize(tTTFPath, static_cast<uint32_t>(tLastCharId), glyphs);
+			mHot.assign(glyphs.size(), Character{});
+			//Glyphs go to shared atlas page.
+			if(mAtlas && mMode == TRM_BITMAP) {
+				for (size_t c = 0; c < glyphs.size(); c++) {
+					const GlyphBitmap& g = glyphs[c];
+					AtlasRegion region;
+					if(g.metrics.size.x > 0 && g.metrics.size.y > 0)
+						region = mAtlas->addAlpha(g.pixels.data(), g.metrics.size.x, g.metrics.size.y);
+					mHot[c] = g.metrics;
+					mHot[c].topLeft = glm::vec2(region.uv.x, region.uv.y);
+					mHot[c].bottomRight = glm::vec2(region.uv.z, region.uv.w);
+					mHot[c].texture = region.texture;
+				}
+				return _loaded();
+			}
+			std::vector<unsigned char> pixels;
+			int side = _bake(glyphs, pixels);
+			_upload(pixels.data(), side);
+			if(cacheable) {
+				std::vector<KerningPair> kerning;
+				kerning.reserve(mKerning.size());
+				for(const auto& pair : mKerning)
+					kerning.push_back({ static_cast<uint32_t>(pair.first >> 32), static_cast<uint32_t>(pair.first), pair.second });
+				FontCache::save(key, mHot, kerning, pixels.data(), side);
+			}
+			return _loaded();
+		}
+
+		void draw(Shader* tShader, std::string tText, glm::vec2 tProjectionSize, glm::vec2 tPosition, glm::vec2 tSize, glm::vec4 tColor) {
+			draw(tShader,tText,tProjectionSize,glm::vec3(tPosition,0),tSize,tColor);
+		}
+
+		//Text is UTF-8. Bytes that aren't valid UTF-8 are taken as Latin-1.
+		void draw(Shader* tShader, std::string tText, glm::vec2 tProjectionSize, glm::vec3 tPosition, glm::vec2 tSize, glm::vec4 tColor) {
+			_draw(tShader, tText, tProjectionSize, tPosition, tSize, tColor, TextEffects());
+		}
+		//Draws with built-in shader. Needed for SDF fonts (and their effects), works for bitmap ones too.
+		void draw(const std::string& tText, const glm::vec2 tProjectionSize, const glm::vec3 tPosition, const glm::vec2 tSize,
+			const glm::vec4 tColor, const TextEffects& tEffects = TextEffects()) {
+			_draw(nullptr, tText, tProjectionSize, tPosition, tSize, tColor, tEffects);
+		}
+
+		//Width of the string (pen advance with kerning) drawn at given scale, in pixels.
+		//Strings that are queried repeatedly are better kept in TextMetrics.
+		float measure(const std::string& tText, const float tScale = 1) {
+			if(!TextRenderer::isInitialized()) return 0;
+			int pen = 0;
+			uint32_t previous = 0;
+			for(size_t i = 0, len = tText.size(); i < len;) {
+				uint32_t code = _decode(tText, i);
+				pen += _kerning(previous, code);
+				previous = code;
+				if(const Character* glyph = _glyph(code)) pen += glyph->advance >> 6;
+			}
+			return pen * tScale;
+		}
+		//Byte of the caret position closest to given pen position (from the string start) in the string drawn at given scale.
+		//Metrics of recently hit strings are kept, so repeated queries on the same string are binary searches.
+		size_t hitTest(const std::string& tText, const float tX, const float tScale = 1) {
+			if(!TextRenderer::isInitialized()) return 0;
+			return getMetrics(tText).hitTest(tX, tScale);
+		}
+		//Measured string from the font's small cache of recently used ones.
+		//Reference stays valid until next call or font reload.
+		const TextMetrics& getMetrics(const std::string& tText) {
+			uint64_t use = ++mMetricsClock;
+			size_t hash = std::hash<std::string>()(tText);
+			auto it = mMetrics.find(hash);
+			if(it == mMetrics.end()) {
+				//Least recently used entry makes room.
+				if(mMetrics.size() >= METRICS_CACHE) {
+					auto oldest = mMetrics.begin();
+					for(auto e = mMetrics.begin(); e != mMetrics.end(); e++)
+						if(e->second.lastUse < oldest->second.lastUse) oldest = e;
+					mMetrics.erase(oldest);
+				}
+				it = mMetrics.emplace(hash, CachedMetrics()).first;
+			}
+			it->second.lastUse = use;
+			it->second.metrics.set(*this, tText);
+			return it->second.metrics;
+		}
+
+		//Queues glyph quads of the string into batch. Position is the baseline start, as in draw().
+		//Glyphs rasterized on demand are safe from eviction until batch end only inside TextRenderer::beginBatch()/endBatch().
+		//SDF fonts draw nothing here, as SpriteBatch shader reads glyph textures as coverage.
+		void draw(SpriteBatch& tBatch, const std::string& tText, glm::vec3 tPosition, const glm::vec2 tSize, const glm::vec4 tColor) {
+			if (!TextRenderer::isInitialized()) return;
+			if(mMode == TRM_SDF) {
+				if(!mBatchWarned) LOG_WARN("SDF font can't be drawn through SpriteBatch, use draw() with a shader.");
+				mBatchWarned = true;
+				return;
+			}
+			TextRenderer::_tick();
+			uint32_t previous = 0;
+			for (size_t i = 0, len = tText.size(); i < len;) {
+				uint32_t code = _decode(tText, i);
+				tPosition.x += _kerning(previous, code) * tSize.x;
+				previous = code;
+				const Character* glyph = _glyph(code);
+				if(!glyph) continue;
+				const Character& c = *glyph;
+				if(c.size.x > 0 && c.size.y > 0)
+					tBatch.draw(c.texture, glm::vec3(tPosition.x + c.bearing.x * tSize.x, tPosition.y + c.bearing.y * tSize.y, tPosition.z),
+						glm::vec2(c.size) * tSize, 0, tColor, glm::vec4(c.topLeft, c.bottomRight),
+						SpriteBatch::FLAG_TEXTURE | SpriteBatch::FLAG_FONT);
+				tPosition.x += (c.advance >> 6) * tSize.x;
+			}
+		}
+
+		void remove() {
+			if(!TextRenderer::isInitialized()) return;
+			if(mTextureID) {
+				glDeleteTextures(1, &mTextureID);
+				UIRender::trackDeleted();
+			}
+			if(mFace) FT_Done_Face(mFace);
+			mFace = nullptr;
+			mPath.clear();
+			mTextureID = 0;
+			mHot.clear();
+			mKerning.clear();
+			mMetrics.clear();
+			mDynamic.remove();
+			mGeneration++;
+		}
+
+		~Text() { remove(); }
+
+		//Glyphs rasterized on demand.
+		const GlyphCache& getGlyphCache() const { return mDynamic; }
+		//Pixel height given to loadFont() (reference size of SDF fonts).
+		int getHeight() const { return mHeight; }
+		TextRenderMode getMode() const { return mMode; }
+		//Highest glyph top above baseline and lowest glyph bottom below it (of preloaded range), at loaded size.
+		int getAscent() const { return mAscent; }
+		int getDescent() const { return mDescent; }
+		int getLineHeight() const { return mAscent + mDescent; }
+		//Changes whenever glyphs do (reload, eviction of on-demand glyphs).
+		unsigned int getGeneration() const { return mGeneration; }
+	private:
+		int mHeight = 0, mAscent = 0, mDescent = 0;
+		TextRenderMode mMode = TRM_BITMAP;
+		int mSpread = 8;
+		bool mBatchWarned = false;
+		//Bumped when glyphs change, so meshes built from old ones know to re-layout.
+		unsigned int mGeneration = 0;
+		FT_Face mFace = nullptr;
+		std::string mPath;
+		//Preloaded range, indexed by code point. Glyphs that failed to load are empty.
+		std::vector<Character> mHot;
+		//Pen adjustments (pixels at loaded size) between code points of preloaded range, by _pair().
+		std::unordered_map<uint64_t, int> mKerning;
+		//Recently used strings of getMetrics().
+		static const size_t METRICS_CACHE = 32;
+		struct CachedMetrics {
+			TextMetrics metrics;
+			uint64_t lastUse = 0;
+		};
+		std::unordered_map<size_t, CachedMetrics> mMetrics;
+		uint64_t mMetricsClock = 0;
+		GlyphCache mDynamic;
+		unsigned int mTextureID = 0;
+		TextureAtlas* mAtlas = nullptr;
+		//Scratch of draw(): quads and (texture, vertex count) runs.
+		std::vector<float> mVertices;
+		std::vector<std::pair<unsigned int, size_t>> mRuns;
+
+		//Glyph rendered into CPU memory (rows from top, no padding).
+		struct GlyphBitmap {
+			Character metrics{};
+			std::vector<unsigned char> pixels;
+			bool failed = false;
+		};
+
+		//Renders glyphs [0;count) split between threads. Every thread opens its own face,
+		//as FreeType faces can't be shared between threads.
+		void _rasterize(const std::string& tPath, const uint32_t tCount, std::vector<GlyphBitmap>& tGlyphs) const {
+			tGlyphs.assign(tCount, GlyphBitmap());
+			unsigned int threads = std::thread::hardware_concurrency();
+			if(threads > 4) threads = 4;
+			if(threads > tCount / 64) threads = tCount / 64;
+			if(threads < 1) threads = 1;
+			//Creating and freeing faces goes through the shared library, so it's locked.
+			std::mutex libraryMutex;
+			auto work = [&](const unsigned int tFirst, FT_Face tFace) {
+				FT_Face face = tFace;
+				if(!face) {
+					std::lock_guard<std::mutex> lock(libraryMutex);
+					if(FT_New_Face(gFreeType, tPath.c_str(), 0, &face)) face = nullptr;
+				}
+				if(face) FT_Set_Pixel_Sizes(face, 0, mHeight);
+				//Glyphs are interleaved between threads, so complex ones don't pile up in one thread.
+				for(uint32_t c = tFirst; c < tCount; c += threads) {
+					GlyphBitmap& g = tGlyphs[c];
+					if(!face || !_render(face, c)) {
+						g.failed = true;
+						continue;
+					}
+					const FT_GlyphSlot glyph = face->glyph;
+					g.metrics.size = glm::ivec2(glyph->bitmap.width, glyph->bitmap.rows);
+					g.metrics.bearing = glm::ivec2(glyph->bitmap_left, glyph->bitmap_top);
+					g.metrics.advance = static_cast<unsigned int>(glyph->advance.x);
+					g.pixels.resize(static_cast<size_t>(g.metrics.size.x) * g.metrics.size.y);
+					for(int y = 0; y < g.metrics.size.y; y++)
+						memcpy(&g.pixels[static_cast<size_t>(y) * g.metrics.size.x], glyph->bitmap.buffer + y * glyph->bitmap.pitch, g.metrics.size.x);
+				}
+				if(face && face != tFace) {
+					std::lock_guard<std::mutex> lock(libraryMutex);
+					FT_Done_Face(face);
+				}
+			};
+			std::vector<std::thread> workers;
+			for(unsigned int i = 1; i < threads; i++) workers.emplace_back(work, i, nullptr);
+			//Calling thread uses the font's own face.
+			work(0, mFace);
+			for(auto& t : workers) t.join();
+			for(uint32_t c = 0; c < tCount; c++)
+				if(tGlyphs[c].failed) LOG_ERRR("Couldn't load glyph #" + std::to_string(c) + ".");
+		}
+		//Packs glyphs into power of two square bitmap. Returns its side.
+		//Glyphs with pixels get texture 1 until _upload().
+		int _bake(const std::vector<GlyphBitmap>& tGlyphs, std::vector<unsigned char>& tPixels) {
+			//Tall glyphs first pack tighter.
+			std::vector<size_t> order;
+			size_t area = 0;
+			for(size_t c = 0; c < tGlyphs.size(); c++) {
+				glm::ivec2 size = tGlyphs[c].metrics.size;
+				if(size.x <= 0 || size.y <= 0) continue;
+				order.push_back(c);
+				area += static_cast<size_t>(size.x + 1) * (size.y + 1);
+			}
+			std::stable_sort(order.begin(), order.end(), [&](const size_t tA, const size_t tB) {
+				return tGlyphs[tA].metrics.size.y > tGlyphs[tB].metrics.size.y;
+			});
+			int maxSize = 0;
+			glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+			int side = 64;
+			while(static_cast<size_t>(side) * side < area) side *= 2;
+			std::vector<glm::ivec2> positions;
+			SkylinePacker packer;
+			size_t unplaced = 0;
+			for(;; side *= 2) {
+				//Last try is at the largest texture GL has and keeps what fits.
+				bool last = side >= maxSize;
+				if(last) side = maxSize;
+				//Every try starts clean, so positions of smaller ones don't linger.
+				positions.assign(tGlyphs.size(), glm::ivec2(-1));
+				packer.reset(side, side);
+				unplaced = 0;
+				for(size_t c : order) {
+					if(packer.pack(tGlyphs[c].metrics.size.x + 1, tGlyphs[c].metrics.size.y + 1, positions[c])) continue;
+					positions[c] = glm::ivec2(-1);
+					unplaced++;
+					if(!last) break;
+				}
+				if(unplaced == 0 || last) break;
+			}
+			if(unplaced) LOG_WARN(std::to_string(unplaced) + " glyphs of " + std::to_string(mHeight) + "px font don't fit into "
+				+ std::to_string(maxSize) + "px texture, they are left out.");
+			tPixels.assign(static_cast<size_t>(side) * side, 0);
+			for(size_t c = 0; c < tGlyphs.size(); c++) {
+				const GlyphBitmap& g = tGlyphs[c];
+				mHot[c] = g.metrics;
+				glm::ivec2 p = positions[c];
+				if(g.pixels.empty() || p.x < 0 || p.x + g.metrics.size.x > side || p.y + g.metrics.size.y > side) continue;
+				for(int y = 0; y < g.metrics.size.y; y++)
+					memcpy(&tPixels[static_cast<size_t>(p.y + y) * side + p.x], &g.pixels[static_cast<size_t>(y) * g.metrics.size.x], g.metrics.size.x);
+				mHot[c].topLeft = glm::vec2(p) / static_cast<float>(side);
+				mHot[c].bottomRight = glm::vec2(p + g.metrics.size) / static_cast<float>(side);
+				mHot[c].texture = 1;
+			}
+			return side;
+		}
+		//Finishes loadFont(): line metrics come from glyphs, as cached fonts have no face to ask.
+		bool _loaded() {
+			mAscent = mDescent = 0;
+			for(const Character& c : mHot) {
+				if(c.size.y <= 0) continue;
+				mAscent = std::max(mAscent, c.bearing.y);
+				mDescent = std::max(mDescent, c.size.y - c.bearing.y);
+			}
+			return true;
+		}
+		static uint64_t _pair(const uint32_t tLeft, const uint32_t tRight) {
+			return (static_cast<uint64_t>(tLeft) << 32) | tRight;
+		}
+		//Pen adjustment between two code points, in pixels at loaded size.
+		int _kerning(const uint32_t tLeft, const uint32_t tRight) const {
+			if(mKerning.empty()) return 0;
+			auto it = mKerning.find(_pair(tLeft, tRight));
+			return it == mKerning.end() ? 0 : it->second;
+		}
+		//Reads kerning of every pair of the preloaded range from face's kern table.
+		//Fonts with GPOS kerning only have none here.
+		void _loadKerning(const uint32_t tCount) {
+			mKerning.clear();
+			if(!mFace || !FT_HAS_KERNING(mFace)) return;
+			std::vector<FT_UInt> indices(tCount, 0);
+			//Control characters are never kerned.
+			for(uint32_t c = 32; c < tCount; c++) indices[c] = FT_Get_Char_Index(mFace, c);
+			for(uint32_t l = 32; l < tCount; l++) {
+				if(!indices[l]) continue;
+				for(uint32_t r = 32; r < tCount; r++) {
+					FT_Vector delta;
+					if(!indices[r] || FT_Get_Kerning(mFace, indices[l], indices[r], FT_KERNING_DEFAULT, &delta)) continue;
+					int value = static_cast<int>(delta.x >> 6);
+					if(value) mKerning[_pair(l, r)] = value;
 				}
-				//Update atlas variables.
-				atlasWidth += font->glyph->bitmap.width;
-				if(atlasHeight<static_cast<int>(font->glyph->bitmap.rows))
-					atlasHeight = static_cast<int>(font->glyph->bitmap.rows);
 			}
-			//Generate texture.
+		}
+		//Uploads baked atlas with one call.
+		void _upload(const unsigned char* tPixels, const int tSide) {
 			glGenTextures(1, &mTextureID);
+			for(Character& c : mHot)
+				if(c.texture) c.texture = mTextureID;
 			glBindTexture(GL_TEXTURE_2D, mTextureID);
-			glTexImage2D(
-				GL_TEXTURE_2D,
-				0,
-				GL_RED,
-				atlasWidth,
-				atlasHeight,
-				0,
-				GL_RED,
-				GL_UNSIGNED_BYTE,
-				nullptr
-			);
+			//Disables the byte-alignment restriction so can use 1 byte for each pixel.
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, tSide, tSide, 0, GL_RED, GL_UNSIGNED_BYTE, tPixels);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 			//Set texture parameters.
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			//Place glyphs into atlas.
-			int x = 0;
-			for (unsigned char c = 0; c < tLastCharId; c++) {
-				//Load glyph.
-				if(FT_Load_Char(font, static_cast<char>(c), FT_LOAD_RENDER)) {
-					std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-					continue;
-				}
-				//Add glyph to texture atlas.
-				glTextureSubImage2D(
-					mTextureID,
-					0,
-					x,
-					0,
-					font->glyph->bitmap.width,
-					font->glyph->bitmap.rows,
-					GL_RED,
-					GL_UNSIGNED_BYTE,
-					font->glyph->bitmap.buffer
-				);
-				//Store glyph information in character map.
-				glm::ivec2 Size = glm::ivec2(font->glyph->bitmap.width, font->glyph->bitmap.rows);
-				Character character{
-					Size,
-					glm::ivec2(font->glyph->bitmap_left, font->glyph->bitmap_top),
-					static_cast<unsigned int>(font->glyph->advance.x),
-
-					glm::vec2(static_cast<float>(x) / static_cast<float>(atlasWidth),0.0f),
-					glm::vec2(static_cast<float>(x + Size.x) / static_cast<float>(atlasWidth), static_cast<float>(Size.y) / static_cast<float>(atlasHeight))
-				};
-				mChars.insert(std::pair<char, Character>(c, character));
-
-				// update x position for next glyph
-				x += font->glyph->bitmap.width;
-			}
-			//Signal that font was loaded.
 			glBindTexture(GL_TEXTURE_2D, 0);
-			FT_Done_Face(font);
-			//Config VAO and VBO.
-			glGenVertexArrays(1, &mTextVAO);
-			glGenBuffers(1, &mTextVBO);
-			glBindVertexArray(mTextVAO);
-			glBindBuffer(GL_ARRAY_BUFFER, mTextVBO);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			glBindVertexArray(0);
+			UIRender::trackCreated();
+		}
+
+		void _draw(const Shader* tShader, const std::string& tText, const glm::vec2 tProjectionSize, glm::vec3 tPosition, const glm::vec2 tSize,
+			const glm::vec4 tColor, const TextEffects& tEffects) {
+			if (!TextRenderer::isInitialized()) return;
+			TextRenderer::_tick();
+			//Build quads of whole string, grouped by texture (glyphs may lie on different pages).
+			mVertices.clear();
+			mRuns.clear();
+			uint32_t previous = 0;
+			for (size_t i = 0, len = tText.size(); i < len;) {
+				uint32_t code = _decode(tText, i);
+				tPosition.x += _kerning(previous, code) * tSize.x;
+				previous = code;
+				const Character* glyph = _glyph(code);
+				if(!glyph) continue;
+				const Character& c = *glyph;
+				if(c.size.x > 0 && c.size.y > 0) {
+					float xpos = tPosition.x + c.bearing.x * tSize.x;
+					float ypos = tPosition.y - (c.size.y - c.bearing.y) * tSize.y; // characters might need to be shifted below baseline
+					float w = c.size.x * tSize.x, h = c.size.y * tSize.y;
+					glm::vec2 b = c.bottomRight, t = c.topLeft;
+					float vertices[6][4] = {
+						//		X		  Y				UV
+							{ xpos,     ypos + h,   t.x, t.y },
+							{ xpos,     ypos,       t.x, b.y },
+							{ xpos + w, ypos,       b.x, b.y },
+
+							{ xpos,     ypos + h,   t.x, t.y },
+							{ xpos + w, ypos,       b.x, b.y },
+							{ xpos + w, ypos + h,   b.x, t.y }
+					};
+					_appendQuad(c.texture, &vertices[0][0]);
+				}
+				//Advance cursor.
+				tPosition.x += (c.advance >> 6) * tSize.x; // multiply by 64
+			}
+			if(mVertices.empty()) return;
+			//One write into the ring and one draw per texture.
+			TextRenderer::_submit(tShader, tProjectionSize, tPosition.z, tColor, tEffects, mMode == TRM_SDF ? static_cast<float>(mSpread) : 0, mVertices, mRuns);
+		}
+		//Opens face used for rasterizing (lazily, for fonts that came from cache).
+		bool _openFace() {
+			if(mFace) return true;
+			if(mPath.empty()) return false;
+			if(FT_New_Face(gFreeType, mPath.c_str(), 0, &mFace)) {
+				LOG_ERRR("Couldn't load font file \"" + mPath + "\".");
+				mFace = nullptr;
+				mPath.clear();
+				return false;
+			}
+			//Set height and dynamic width.
+			FT_Set_Pixel_Sizes(mFace, 0, mHeight);
 			return true;
 		}
+		//Loads glyph into face's slot and renders it the way font mode asks.
+		bool _render(FT_Face tFace, const uint32_t tCode) const {
+			if(mMode == TRM_BITMAP) return FT_Load_Char(tFace, tCode, FT_LOAD_RENDER) == 0;
+			return FT_Load_Char(tFace, tCode, FT_LOAD_DEFAULT) == 0 && FT_Render_Glyph(tFace->glyph, FT_RENDER_MODE_SDF) == 0;
+		}
+		//Spread is a setting of the whole library, so it's set before every rendering.
+		void _applySpread() const {
+			if(mMode == TRM_SDF) FT_Property_Set(gFreeType, "sdf", "spread", &mSpread);
+		}
+		//Reads code point at given byte and moves index past it.
+		static uint32_t _decode(const std::string& tText, size_t& tIndex) {
+			const unsigned char* s = reinterpret_cast<const unsigned char*>(tText.data());
+			size_t len = tText.size();
+			unsigned char lead = s[tIndex];
+			int extra = lead < 0x80 ? 0 : (lead >> 5) == 0x6 ? 1 : (lead >> 4) == 0xE ? 2 : (lead >> 3) == 0x1E ? 3 : -1;
+			if(extra > 0 && tIndex + extra < len) {
+				uint32_t code = lead & (0x3F >> extra);
+				size_t i = 1;
+				for(; i <= static_cast<size_t>(extra) && (s[tIndex + i] & 0xC0) == 0x80; i++)
+					code = (code << 6) | (s[tIndex + i] & 0x3F);
+				if(i > static_cast<size_t>(extra)) {
+					tIndex += i;
+					return code;
+				}
+			}
+			tIndex++;
+			return lead;
+		}
+		//Length of the common start of two strings (compared by blocks, as logs can be long).
+		static size_t _common(const std::string& tA, const std::string& tB) {
+			size_t len = std::min(tA.size(), tB.size()), i = 0;
+			while(i + 64 <= len && memcmp(tA.data() + i, tB.data() + i, 64) == 0) i += 64;
+			while(i < len && tA[i] == tB[i]) i++;
+			return i;
+		}
+		//Glyph of given code point (rasterizing it if needed) or nullptr.
+		const Character* _glyph(const uint32_t tCode) {
+			if(tCode < mHot.size()) return &mHot[tCode];
+			uint64_t tick = TextRenderer::_state().tick;
+			if(const Character* c = mDynamic.find(tCode, tick)) return c;
+			_applySpread();
+			if(!_openFace() || !_render(mFace, tCode)) return nullptr;
+			FT_GlyphSlot glyph = mFace->glyph;
+			Character metrics{
+				glm::ivec2(glyph->bitmap.width, glyph->bitmap.rows),
+				glm::ivec2(glyph->bitmap_left, glyph->bitmap_top),
+				static_cast<unsigned int>(glyph->advance.x),
+				glm::vec2(0), glm::vec2(0), 0
+			};
+			bool evicted = false;
+			const Character* c = mDynamic.insert(tCode, metrics, glyph->bitmap.buffer, glyph->bitmap.pitch, tick, TextRenderer::_pinned(), evicted);
+			if(evicted) mGeneration++;
+			return c;
+		}
 
-		void draw(Shader* tShader, std::string tText, glm::vec2 tProjectionSize, glm::vec2 tPosition, glm::vec2 tSize, glm::vec4 tColor) {
-			draw(tShader,tText,tProjectionSize,glm::vec3(tPosition,0),tSize,tColor);
+		//Adds quad to the run of its texture (runs are few, usually one).
+		void _appendQuad(const unsigned int tTexture, const float* tQuad) {
+			if(mRuns.empty() || mRuns.back().first == tTexture) {
+				if(mRuns.empty()) mRuns.push_back({ tTexture, 0 });
+				mVertices.insert(mVertices.end(), tQuad, tQuad + 24);
+				mRuns.back().second += 6;
+				return;
+			}
+			//Texture changed mid string: insert quad after the end of its texture's run.
+			size_t offset = 0;
+			for(auto& run : mRuns) {
+				offset += run.second * 4;
+				if(run.first != tTexture) continue;
+				mVertices.insert(mVertices.begin() + offset, tQuad, tQuad + 24);
+				run.second += 6;
+				return;
+			}
+			mRuns.push_back({ tTexture, 6 });
+			mVertices.insert(mVertices.end(), tQuad, tQuad + 24);
+		}
+	};
+
+	inline bool TextMetrics::set(Text& tFont, const std::string& tText) {
+		bool same = mFont == &tFont && mGeneration == tFont.mGeneration && !mBytes.empty();
+		if(same && tText == mText) return false;
+		//Characters before first differing byte keep their positions.
+		size_t from = 0;
+		if(same) {
+			size_t keep = Text::_common(mText, tText);
+			from = std::lower_bound(mBytes.begin(), mBytes.end(), keep) - mBytes.begin();
+			//Character that continues past the common part is measured again.
+			if(from < mBytes.size() && mBytes[from] > keep) from--;
+		}
+		mFont = &tFont;
+		mGeneration = tFont.mGeneration;
+		mText = tText;
+		_measure(tFont, from);
+		return true;
+	}
+	inline void TextMetrics::_measure(Text& tFont, size_t tFrom) {
+		int pen = 0;
+		uint32_t previous = 0;
+		size_t i = 0;
+		if(tFrom) {
+			i = mBytes[tFrom - 1];
+			pen = mPens[tFrom - 1];
+			previous = Text::_decode(mText, i);
+			if(const Character* glyph = tFont._glyph(previous)) pen += glyph->advance >> 6;
 		}
+		mBytes.resize(tFrom);
+		mPens.resize(tFrom);
+		while(i < mText.size()) {
+			mBytes.push_back(i);
+			uint32_t code = Text::_decode(mText, i);
+			pen += tFont._kerning(previous, code);
+			previous = code;
+			mPens.push_back(pen);
+			if(const Character* glyph = tFont._glyph(code)) pen += glyph->advance >> 6;
+		}
+		mBytes.push_back(mText.size());
+		mPens.push_back(pen);
+		//Rasterizing new glyphs could have evicted others.
+		mGeneration = tFont.mGeneration;
+	}
 
-		void draw(Shader* tShader, std::string tText, glm::vec2 tProjectionSize, glm::vec3 tPosition, glm::vec2 tSize, glm::vec4 tColor) {
-			if (!TextRenderer::isInitialized()) return;
-			if (!gDone) {
-				FT_Done_FreeType(gFreeType);
-				gDone = true;
-			}
-			//Setup shader.
-			tShader->enable();
-			tShader->setBool("isFont", true);
-			tShader->setBool("hasTexture", true);
-			tShader->setVec4("color", tColor);
-			tShader->setMat4("projection", glm::ortho(0.f, tProjectionSize.x, 0.f, tProjectionSize.y));
-			tShader->setMat4("model", glm::translate(glm::mat4(1), glm::vec3(0,0,tPosition.z)));
-			//Setup render data.
-			glActiveTexture(GL_TEXTURE0);
-			glBindVertexArray(mTextVAO);
-			glBindTexture(GL_TEXTURE_2D, mTextureID);
-			glBindBuffer(GL_ARRAY_BUFFER, mTextVBO);
-			//Setup advancable data.
-			Character c{};
-			float xpos, ypos; // characters might need to be shifted below baseline
-			float w = c.size.x * tSize.x, h = c.size.y * tSize.y;
-			//Go through all characters of string.
-			for (size_t i = 0, len = tText.size(); i < len; i++) {
-				//Advance data.
-				c = mChars[tText[i]];
-				xpos = tPosition.x + c.bearing.x * tSize.x;
-				ypos = tPosition.y - (c.size.y - c.bearing.y) * tSize.y;
-				w = c.size.x * tSize.x, h = c.size.y * tSize.y;
-				//New VBO data.
-				glm::vec2 b = c.bottomRight, t = c.topLeft;
-				float vertices[6][4] = {
-					//		X		  Y				UV
-						{ xpos,     ypos + h,   t.x, t.y },
-						{ xpos,     ypos,       t.x, b.y },
-						{ xpos + w, ypos,       b.x, b.y },
-			
-						{ xpos,     ypos + h,   t.x, t.y },
-						{ xpos + w, ypos,       b.x, b.y },
-						{ xpos + w, ypos + h,   b.x, t.y }
-				};
-				//Render quad.
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-				glDrawArrays(GL_TRIANGLES, 0, 6);
-				//Advance cursor.
-				tPosition.x += (c.advance >> 6) * tSize.x; // multiply by 64 
+
+	//String laid out once into own vertex buffer. Every frame only the draw (with transform in "model" uniform) is submitted.
+	//set() can be called each frame: layout is rebuilt only when string or style changes,
+	//and when only the end of string changed (counters, typing) only the changed suffix is rebuilt and uploaded.
+	class TextMesh {
+	public:
+		~TextMesh() { remove(); }
+		TextMesh() = default;
+		TextMesh(const TextMesh&) = delete;
+		TextMesh& operator=(const TextMesh&) = delete;
+
+		//Returns true if layout was rebuilt. Font has to outlive the mesh.
+		bool set(Text& tFont, const std::string& tText, const glm::vec2 tScale = glm::vec2(1), const glm::vec4 tColor = glm::vec4(1)) {
+			mColor = tColor;
+			size_t style = _hash(&tFont, tFont.mGeneration, tScale);
+			size_t text = std::hash<std::string>()(tText);
+			if(mVAO && style == mStyleHash && text == mTextHash) return false;
+			//Glyphs before first differing character stay as they are.
+			size_t keep = 0;
+			if(style == mStyleHash) {
+				while(keep < mText.size() && keep < tText.size() && mText[keep] == tText[keep]) keep++;
+				//Don't split a multi-byte character.
+				while(keep > 0 && keep < tText.size() && (static_cast<unsigned char>(tText[keep]) & 0xC0) == 0x80) keep--;
 			}
-			//Clear bindings.
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			glBindVertexArray(0);
-			glBindTexture(GL_TEXTURE_2D, 0);
+			mStyleHash = style;
+			mTextHash = text;
+			mText = tText;
+			mFont = &tFont;
+			mScale = tScale;
+			_layout(keep);
+			return true;
+		}
+		//Position is baseline start, as in Text::draw().
+		void draw(const Shader* tShader, const glm::vec2 tProjectionSize, const glm::vec3 tPosition) {
+			_draw(tShader, tProjectionSize, tPosition, TextEffects());
+		}
+		//Draws with built-in shader (needed for SDF fonts).
+		void draw(const glm::vec2 tProjectionSize, const glm::vec3 tPosition, const TextEffects& tEffects = TextEffects()) {
+			_draw(nullptr, tProjectionSize, tPosition, tEffects);
 		}
 
 		void remove() {
-			if(!TextRenderer::isInitialized()) return;
-			glDeleteVertexArrays(1, &mTextVAO);
-			glDeleteBuffers(1, &mTextVBO);
-			mChars.clear();
+			if(!mVAO) return;
+			glDeleteVertexArrays(1, &mVAO);
+			glDeleteBuffers(1, &mVBO);
+			UIRender::trackDeleted(2);
+			mVAO = mVBO = 0;
+			mCapacity = 0;
+			mStyleHash = mTextHash = 0;
+			mFont = nullptr;
+			mText.clear();
+			mGlyphs.clear();
+			mVertices.clear();
+			mRuns.clear();
 		}
 
-		~Text() { remove(); }
+		//Width of laid out string (pen advance), in pixels.
+		float getWidth() const { return mGlyphs.empty() ? 0 : mGlyphs.back().pen; }
+		size_t getGlyphCount() const { return mVertices.size() / 24; }
+		//Bytes uploaded by the last set() that rebuilt layout.
+		size_t getUploadedBytes() const { return mUploaded; }
 	private:
-		int mHeight = 0;
-		std::map<char, Character> mChars;
-		unsigned int mTextVAO = 0, mTextVBO = 0, mTextureID = 0;
+		//Where character starts in the string, where its quad ends and where pen stands after it.
+		struct Glyph {
+			size_t byte;
+			size_t vertex;
+			float pen;
+			unsigned int texture;
+		};
+
+		static size_t _hash(const Text* tFont, const unsigned int tGeneration, const glm::vec2 tScale) {
+			size_t h = std::hash<const void*>()(tFont);
+			h ^= std::hash<unsigned int>()(tGeneration) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<float>()(tScale.x) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<float>()(tScale.y) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+
+		void _draw(const Shader* tShader, const glm::vec2 tProjectionSize, const glm::vec3 tPosition, const TextEffects& tEffects) {
+			//Font was reloaded or evicted some on-demand glyphs.
+			if(mFont && mFont->mGeneration != mGeneration) {
+				mStyleHash = _hash(mFont, mFont->mGeneration, mScale);
+				_layout(0);
+			}
+			if(!mVAO || mRuns.empty()) return;
+			TextRenderer::_setup(tShader, tProjectionSize, tPosition, mColor, tEffects,
+				mFont && mFont->mMode == TRM_SDF ? static_cast<float>(mFont->mSpread) : 0);
+			glBindVertexArray(mVAO);
+			size_t first = 0;
+			for(const auto& run : mRuns) {
+				glBindTexture(GL_TEXTURE_2D, run.first);
+				glDrawArrays(GL_TRIANGLES, static_cast<int>(first), static_cast<int>(run.second));
+				first += run.second;
+			}
+			TextRenderer::_unbind();
+		}
+		void _layout(const size_t tKeepBytes) {
+			Text& font = *mFont;
+			mGeneration = font.mGeneration;
+			size_t keep = std::lower_bound(mGlyphs.begin(), mGlyphs.end(), tKeepBytes,
+				[](const Glyph& tGlyph, const size_t tByte) { return tGlyph.byte < tByte; }) - mGlyphs.begin();
+			size_t firstVertex = keep ? mGlyphs[keep - 1].vertex : 0;
+			float pen = keep ? mGlyphs[keep - 1].pen : 0;
+			mGlyphs.resize(keep);
+			mVertices.resize(firstVertex * 4);
+			TextRenderer::_tick();
+			uint32_t previous = 0;
+			if(keep) {
+				size_t last = mGlyphs[keep - 1].byte;
+				previous = Text::_decode(mText, last);
+			}
+			for(size_t i = keep ? tKeepBytes : 0; i < mText.size();) {
+				size_t byte = i;
+				unsigned int texture = 0;
+				uint32_t code = Text::_decode(mText, i);
+				pen += font._kerning(previous, code) * mScale.x;
+				previous = code;
+				if(const Character* glyph = font._glyph(code)) {
+					const Character& c = *glyph;
+					if(c.size.x > 0 && c.size.y > 0) {
+						float xpos = pen + c.bearing.x * mScale.x;
+						float ypos = -(c.size.y - c.bearing.y) * mScale.y;
+						float w = c.size.x * mScale.x, h = c.size.y * mScale.y;
+						glm::vec2 b = c.bottomRight, t = c.topLeft;
+						float vertices[24] = {
+							xpos,     ypos + h,   t.x, t.y,
+							xpos,     ypos,       t.x, b.y,
+							xpos + w, ypos,       b.x, b.y,
+							xpos,     ypos + h,   t.x, t.y,
+							xpos + w, ypos,       b.x, b.y,
+							xpos + w, ypos + h,   b.x, t.y
+						};
+						mVertices.insert(mVertices.end(), vertices, vertices + 24);
+						texture = c.texture;
+					}
+					pen += (c.advance >> 6) * mScale.x;
+				}
+				mGlyphs.push_back({ byte, mVertices.size() / 4, pen, texture });
+			}
+			_runs();
+			_upload(firstVertex);
+		}
+		//Consecutive quads of same texture, drawn by one call each.
+		void _runs() {
+			mRuns.clear();
+			size_t previous = 0;
+			for(const Glyph& g : mGlyphs) {
+				size_t count = g.vertex - previous;
+				previous = g.vertex;
+				if(count == 0) continue;
+				if(!mRuns.empty() && mRuns.back().first == g.texture) mRuns.back().second += count;
+				else mRuns.push_back({ g.texture, count });
+			}
+		}
+		void _upload(size_t tFirstVertex) {
+			if(!mVAO) {
+				glGenVertexArrays(1, &mVAO);
+				glGenBuffers(1, &mVBO);
+				UIRender::trackCreated(2);
+				glBindVertexArray(mVAO);
+				glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+				glEnableVertexAttribArray(0);
+				glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, TextRenderer::VERTEX_SIZE, 0);
+				glBindVertexArray(0);
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+			size_t bytes = mVertices.size() * sizeof(float);
+			if(bytes > mCapacity) {
+				//Leave room for string to grow a bit without reallocating.
+				mCapacity = bytes + bytes / 2 + 24 * sizeof(float);
+				glBufferData(GL_ARRAY_BUFFER, static_cast<long>(mCapacity), nullptr, GL_DYNAMIC_DRAW);
+				tFirstVertex = 0;
+			}
+			size_t offset = tFirstVertex * TextRenderer::VERTEX_SIZE;
+			mUploaded = bytes - offset;
+			if(mUploaded) glBufferSubData(GL_ARRAY_BUFFER, static_cast<long>(offset), static_cast<long>(mUploaded), mVertices.data() + tFirstVertex * 4);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+
+		unsigned int mVAO = 0, mVBO = 0;
+		size_t mCapacity = 0, mUploaded = 0;
+		size_t mStyleHash = 0, mTextHash = 0;
+		Text* mFont = nullptr;
+		unsigned int mGeneration = 0;
+		glm::vec2 mScale{1};
+		glm::vec4 mColor{1};
+		std::string mText;
+		std::vector<Glyph> mGlyphs;
+		std::vector<float> mVertices;
+		std::vector<std::pair<unsigned int, size_t>> mRuns;
 	};
 
+	//Text wrapped into lines of given width (at spaces, or inside words longer than a line) and at "\n".
+	//set() can be called each frame: breaks are computed only when string, width or scale change,
+	//and only from the line before the first changed byte (appending to logs and typewriter text flows the last lines only).
+	class TextParagraph {
+	public:
+		//Returns true if lines were broken again. Width is in pixels at given scale. Font has to outlive the paragraph.
+		bool set(Text& tFont, const std::string& tText, const float tWidth, const glm::vec2 tScale = glm::vec2(1)) {
+			size_t text = std::hash<std::string>()(tText);
+			bool sameStyle = mFont == &tFont && mGeneration == tFont.mGeneration && mWidth == tWidth && mScale == tScale;
+			if(sameStyle && text == mTextHash) return false;
+			//Lines before the one holding first changed byte stay. The line before it is flowed too,
+			//as its last word may have changed.
+			size_t line = 0;
+			if(sameStyle) {
+				size_t keep = Text::_common(mMetrics.getText(), tText);
+				line = std::upper_bound(mLines.begin(), mLines.end(), keep,
+					[](const size_t tByte, const Line& tLine) { return tByte < tLine.begin; }) - mLines.begin();
+				line = line > 1 ? line - 2 : 0;
+			}
+			mFont = &tFont;
+			mTextHash = text;
+			mWidth = tWidth;
+			mScale = tScale;
+			mMetrics.set(tFont, tText);
+			//Measuring could rasterize glyphs and evict others: whole text was measured again then.
+			if(mGeneration != tFont.mGeneration) line = 0;
+			mGeneration = tFont.mGeneration;
+			_flow(line);
+			return true;
+		}
+		//Distance between baselines, as a multiple of font's line height.
+		void setLineSpacing(const float tSpacing) { mSpacing = tSpacing; }
+		void setAlign(const TextAlign tAlign) { mAlign = tAlign; }
+
+		//Position is the top left corner of the paragraph box. Lines outside the projection aren't drawn.
+		void draw(const Shader* tShader, const glm::vec2 tProjectionSize, const glm::vec3 tPosition, const glm::vec4 tColor) {
+			_draw(tShader, tProjectionSize, tPosition, tColor, TextEffects());
+		}
+		//Draws with built-in shader (needed for SDF fonts).
+		void draw(const glm::vec2 tProjectionSize, const glm::vec3 tPosition, const glm::vec4 tColor, const TextEffects& tEffects = TextEffects()) {
+			_draw(nullptr, tProjectionSize, tPosition, tColor, tEffects);
+		}
+		//Queues glyph quads of all lines into batch.
+		void draw(SpriteBatch& tBatch, const glm::vec3 tPosition, const glm::vec4 tColor) {
+			if(!mFont) return;
+			for(size_t i = 0; i < mLines.size(); i++) {
+				const Line& line = mLines[i];
+				mLine.assign(mMetrics.getText(), line.begin, line.end - line.begin);
+				mFont->draw(tBatch, mLine, _origin(tPosition, i), mScale, tColor);
+			}
+		}
+
+		size_t getLineCount() const { return mLines.size(); }
+		//Bytes of the line's text (without spaces it was broken at and "\n").
+		size_t getLineBegin(const size_t tLine) const { return mLines[tLine].begin; }
+		size_t getLineEnd(const size_t tLine) const { return mLines[tLine].end; }
+		float getLineWidth(const size_t tLine) const { return mLines[tLine].width * mScale.x; }
+		//Distance between baselines, in pixels.
+		float getLineAdvance() const { return mFont ? mFont->getLineHeight() * mSpacing * mScale.y : 0; }
+		//Box taken by the lines (width given to set() and height of all lines).
+		glm::vec2 getSize() const {
+			if(mLines.empty() || !mFont) return glm::vec2(mWidth, 0);
+			return glm::vec2(mWidth, getLineAdvance() * (mLines.size() - 1) + mFont->getLineHeight() * mScale.y);
+		}
+		//Lines broken by the last set() that changed something.
+		size_t getFlowedLines() const { return mFlowed; }
+		const TextMetrics& getMetrics() const { return mMetrics; }
+	private:
+		struct Line {
+			size_t begin, end;		// Bytes of the text.
+			size_t first;			// Character the line starts at.
+			int width;				// Pixels at loaded size.
+		};
+
+		//Breaks lines from given one to the end of text.
+		void _flow(const size_t tLine) {
+			const std::vector<size_t>& bytes = mMetrics.mBytes;
+			const std::vector<int>& pens = mMetrics.mPens;
+			const std::string& text = mMetrics.getText();
+			size_t chars = mMetrics.getCharCount();
+			size_t start = tLine < mLines.size() ? mLines[tLine].first : 0;
+			mLines.resize(tLine < mLines.size() ? tLine : 0);
+			mFlowed = 0;
+			float limit = mScale.x > 0 ? mWidth / mScale.x : 0;
+			while(start < chars) {
+				//Last place the line can be broken at: end of its text and start of the next line.
+				size_t breakEnd = SIZE_MAX, breakNext = 0;
+				size_t c = start, end = chars, next = chars;
+				bool newline = false;
+				for(; c < chars; c++) {
+					char ch = text[bytes[c]];
+					if(ch == '\n') {
+						newline = true;
+						break;
+					}
+					//Spaces can stick out of the line, a run of them is one break.
+					if(ch == ' ') {
+						if(c > start && text[bytes[c - 1]] != ' ') breakEnd = c;
+						if(breakEnd != SIZE_MAX) breakNext = c + 1;
+						continue;
+					}
+					if(c > start && pens[c + 1] - pens[start] > limit) break;
+				}
+				if(newline) {
+					end = c;
+					next = c + 1;
+				} else if(c < chars) {
+					//Word longer than the line is split.
+					end = breakEnd != SIZE_MAX ? breakEnd : c;
+					next = breakEnd != SIZE_MAX ? breakNext : c;
+				}
+				mLines.push_back({ bytes[start], bytes[end], start, pens[end] - pens[start] });
+				mFlowed++;
+				start = next;
+				//Text ending with "\n" has an empty last line.
+				if(newline && start == chars) {
+					mLines.push_back({ bytes[start], bytes[start], start, 0 });
+					mFlowed++;
+				}
+			}
+		}
+		//Baseline start of the line.
+		glm::vec3 _origin(const glm::vec3 tPosition, const size_t tLine) const {
+			float free = mWidth - mLines[tLine].width * mScale.x;
+			float x = mAlign == TA_CENTER ? free * 0.5f : mAlign == TA_RIGHT ? free : 0;
+			return glm::vec3(tPosition.x + x, tPosition.y - mFont->getAscent() * mScale.y - getLineAdvance() * tLine, tPosition.z);
+		}
+		void _draw(const Shader* tShader, const glm::vec2 tProjectionSize, const glm::vec3 tPosition, const glm::vec4 tColor, const TextEffects& tEffects) {
+			if(!mFont || mLines.empty() || !TextRenderer::isInitialized()) return;
+			//Lines are evenly spaced, so visible ones are found without walking the others.
+			float advance = getLineAdvance();
+			size_t first = 0, last = mLines.size();
+			if(advance > 0) {
+				//Baseline of the first line and how far lines reach from baselines.
+				float baseline = tPosition.y - mFont->getAscent() * mScale.y;
+				float above = (baseline - mFont->getDescent() * mScale.y - tProjectionSize.y) / advance;
+				float below = (baseline + mFont->getAscent() * mScale.y) / advance + 1;
+				if(above > 0) first = std::min(mLines.size(), static_cast<size_t>(above));
+				last = below > 0 ? std::min(mLines.size(), static_cast<size_t>(below)) : 0;
+			}
+			if(first >= last) return;
+			//Lines of one paragraph go to GPU together.
+			bool batching = TextRenderer::_state().batching;
+			if(!batching) TextRenderer::beginBatch();
+			for(size_t i = first; i < last; i++) {
+				const Line& line = mLines[i];
+				if(line.begin == line.end) continue;
+				mLine.assign(mMetrics.getText(), line.begin, line.end - line.begin);
+				mFont->_draw(tShader, mLine, tProjectionSize, _origin(tPosition, i), mScale, tColor, tEffects);
+			}
+			if(!batching) TextRenderer::endBatch();
+		}
+
+		Text* mFont = nullptr;
+		unsigned int mGeneration = 0;
+		size_t mTextHash = 0;
+		float mWidth = 0;
+		glm::vec2 mScale{1};
+		float mSpacing = 1;
+		TextAlign mAlign = TA_LEFT;
+		TextMetrics mMetrics;
+		std::vector<Line> mLines;
+		size_t mFlowed = 0;
+		//Scratch of draws: text of one line.
+		std::string mLine;
+	};
 }
 
 #endif // !FS_UI_TEXT
\ No newline at end of file
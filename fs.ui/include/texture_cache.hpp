@@ -0,0 +1,278 @@
+#ifndef FS_UI_TEXTURE_CACHE
+#define FS_UI_TEXTURE_CACHE
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <glm/glm.hpp>
+
+#include "../../../engine/include/common.hpp"
+#include "../../../engine/include/texture.hpp"
+#include "../../../engine/include/utils/stbi_global.hpp"
+#include "render.hpp"
+
+namespace Firesteel {
+	enum TextureLoadFlags {
+		TLF_NONE=0,
+		TLF_FLIP=1		// Flip vertically on load (what Sprite always did).
+	};
+
+	//Texture owned by the cache. Freed when the last handle lets go of it.
+	struct CachedTexture {
+		Texture texture;
+		glm::ivec2 size{0};
+		size_t bytes = 0;		// Estimated VRAM (mip chain included).
+		bool ready = false;		// Async loads are false until TextureCache::pump() uploads them.
+		bool failed = false;
+	};
+	typedef std::shared_ptr<CachedTexture> TextureHandle;
+
+	struct TextureCacheStats {
+		size_t hits = 0, misses = 0;
+		size_t vramBytes = 0;
+		size_t alive = 0;
+		size_t pendingUploads = 0;
+	};
+
+	//Shares textures between everything that loads the same file with same flags.
+	//GL work happens on the calling thread, so use it from the GL thread only.
+	//Async loads decode on cache's own worker threads and get uploaded by pump().
+	class TextureCache {
+	public:
+		static TextureCache& get() {
+			static TextureCache instance;
+			return instance;
+		}
+
+		//Loads texture right away. Returns nullptr if file doesn't exist or can't be decoded.
+		TextureHandle load(const std::string& tPath, const unsigned int tFlags = TLF_FLIP) {
+			std::string key;
+			if(TextureHandle hit = _find(tPath, tFlags, key)) return hit;
+			if(!std::filesystem::exists(tPath)) return nullptr;
+			mStats.misses++;
+			TextureHandle handle = _make(tPath);
+			handle->texture.ID = TextureFromFile(tPath, &handle->texture.isMonochrome, (tFlags & TLF_FLIP) != 0);
+			if(!handle->texture.ID) return nullptr;
+			_measure(*handle);
+			handle->ready = true;
+			mEntries[key] = handle;
+			return handle;
+		}
+		//Returns handle at once and decodes the file in background.
+		//Handle becomes ready (or failed) after a pump() that follows decoding.
+		//Failed handles aren't kept by the cache, so asking for the file again retries it.
+		//With stb_image older than 2.26 (no per-thread flip flag) this loads right away instead.
+		TextureHandle loadAsync(const std::string& tPath, const unsigned int tFlags = TLF_FLIP) {
+			if(!_hasThreadFlip(0)) return load(tPath, tFlags);
+			std::string key;
+			if(TextureHandle hit = _find(tPath, tFlags, key)) return hit;
+			if(!std::filesystem::exists(tPath)) return nullptr;
+			mStats.misses++;
+			TextureHandle handle = _make(tPath);
+			mEntries[key] = handle;
+			_startWorkers();
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mJobs.push_back({ handle, tPath, key, tFlags });
+				mStats.pendingUploads++;
+			}
+			mWake.notify_one();
+			return handle;
+		}
+		//Uploads textures decoded since last call. Call once per frame on the GL thread.
+		void pump(size_t tMaxUploads = static_cast<size_t>(-1)) {
+			std::deque<Decoded> decoded;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				while(!mDecoded.empty() && decoded.size() < tMaxUploads) {
+					decoded.push_back(std::move(mDecoded.front()));
+					mDecoded.pop_front();
+				}
+			}
+			for(Decoded& d : decoded) {
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					mStats.pendingUploads--;
+				}
+				TextureHandle handle = d.handle.lock();
+				if(!handle) {
+					stbi_image_free(d.pixels);
+					continue;
+				}
+				if(!d.pixels) {
+					LOG_WARN("Couldn't decode texture \"" + handle->texture.path + "\".");
+					handle->failed = true;
+					//Next request for the file loads it again.
+					auto it = mEntries.find(d.key);
+					if(it != mEntries.end() && it->second.lock() == handle) mEntries.erase(it);
+					continue;
+				}
+				_upload(*handle, d);
+				stbi_image_free(d.pixels);
+			}
+		}
+
+		TextureCacheStats getStats() {
+			std::lock_guard<std::mutex> lock(mMutex);
+			TextureCacheStats stats = mStats;
+			stats.alive = 0;
+			for(auto it = mEntries.begin(); it != mEntries.end();) {
+				if(it->second.expired()) it = mEntries.erase(it);
+				else { stats.alive++; it++; }
+			}
+			return stats;
+		}
+
+		~TextureCache() {
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mQuit = true;
+			}
+			mWake.notify_all();
+			for(auto& t : mThreads) t.join();
+			for(Decoded& d : mDecoded) stbi_image_free(d.pixels);
+		}
+	private:
+		TextureCache() = default;
+		TextureCache(const TextureCache&) = delete;
+		TextureCache& operator=(const TextureCache&) = delete;
+
+		struct Job {
+			std::weak_ptr<CachedTexture> handle;
+			std::string path, key;
+			unsigned int flags;
+		};
+		struct Decoded {
+			std::weak_ptr<CachedTexture> handle;
+			std::string key;
+			unsigned char* pixels;
+			int width, height, channels;
+		};
+
+		TextureHandle _find(const std::string& tPath, const unsigned int tFlags, std::string& tKey) {
+			std::error_code ec;
+			tKey = std::filesystem::weakly_canonical(tPath, ec).string();
+			if(ec) tKey = tPath;
+			tKey += '|' + std::to_string(tFlags);
+			auto it = mEntries.find(tKey);
+			if(it == mEntries.end()) return nullptr;
+			TextureHandle handle = it->second.lock();
+			if(handle) mStats.hits++;
+			return handle;
+		}
+		//Handle which frees its texture (and VRAM counter) with the last holder.
+		TextureHandle _make(const std::string& tPath) {
+			TextureHandle handle(new CachedTexture(), [this](CachedTexture* tTexture) {
+				if(tTexture->texture.ID) {
+					tTexture->texture.remove();
+					UIRender::trackDeleted();
+					mStats.vramBytes -= tTexture->bytes;
+				}
+				delete tTexture;
+			});
+			handle->texture.path = tPath;
+			return handle;
+		}
+		//Asks GL what was uploaded.
+		void _measure(CachedTexture& tTexture) {
+			int width = 0, height = 0, format = 0, minFilter = 0;
+			glBindTexture(GL_TEXTURE_2D, tTexture.texture.ID);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &minFilter);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			size_t pixel = 4;
+			if(format == GL_RED || format == GL_R8) pixel = 1;
+			else if(format == GL_RG || format == GL_RG8) pixel = 2;
+			else if(format == GL_RGB || format == GL_RGB8) pixel = 3;
+			bool mips = minFilter != GL_LINEAR && minFilter != GL_NEAREST;
+			_account(tTexture, width, height, pixel, mips);
+		}
+		void _account(CachedTexture& tTexture, const int tWidth, const int tHeight, const size_t tPixel, const bool tMips) {
+			tTexture.size = glm::ivec2(tWidth, tHeight);
+			tTexture.bytes = static_cast<size_t>(tWidth) * tHeight * tPixel;
+			if(tMips) tTexture.bytes += tTexture.bytes / 3;
+			mStats.vramBytes += tTexture.bytes;
+			UIRender::trackCreated();
+		}
+		void _upload(CachedTexture& tTexture, const Decoded& tDecoded) {
+			unsigned int format = GL_RGBA;
+			if(tDecoded.channels == 1) format = GL_RED;
+			else if(tDecoded.channels == 2) format = GL_RG;
+			else if(tDecoded.channels == 3) format = GL_RGB;
+			glGenTextures(1, &tTexture.texture.ID);
+			glBindTexture(GL_TEXTURE_2D, tTexture.texture.ID);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, tDecoded.width, tDecoded.height, 0, format, GL_UNSIGNED_BYTE, tDecoded.pixels);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			tTexture.texture.isMonochrome = tDecoded.channels == 1;
+			_account(tTexture, tDecoded.width, tDecoded.height, static_cast<size_t>(tDecoded.channels), true);
+			tTexture.ready = true;
+		}
+
+		void _startWorkers() {
+			if(!mThreads.empty()) return;
+			unsigned int count = std::thread::hardware_concurrency() / 2;
+			if(count < 1) count = 1;
+			if(count > 2) count = 2;
+			for(unsigned int i = 0; i < count; i++)
+				mThreads.emplace_back([this]() { _run(); });
+		}
+		void _run() {
+			while(true) {
+				Job job;
+				{
+					std::unique_lock<std::mutex> lock(mMutex);
+					mWake.wait(lock, [this]() { return mQuit || !mJobs.empty(); });
+					if(mQuit) return;
+					job = std::move(mJobs.front());
+					mJobs.pop_front();
+				}
+				Decoded decoded{ job.handle, job.key, nullptr, 0, 0, 0 };
+				//Nobody waits for it anymore.
+				if(!job.handle.expired()) {
+					_setThreadFlip((job.flags & TLF_FLIP) != 0 ? 1 : 0);
+					decoded.pixels = stbi_load(job.path.c_str(), &decoded.width, &decoded.height, &decoded.channels, 0);
+				}
+				std::lock_guard<std::mutex> lock(mMutex);
+				mDecoded.push_back(std::move(decoded));
+			}
+		}
+
+		//stbi_set_flip_vertically_on_load_thread() came with stb_image 2.26 and STBI_VERSION doesn't tell versions apart,
+		//so these check whether it's declared. The global flag can't be used off the GL thread, TextureFromFile() sets it too.
+		template<typename T>
+		static constexpr auto _hasThreadFlip(const T tFlag) -> decltype(stbi_set_flip_vertically_on_load_thread(tFlag), true) { return true; }
+		static constexpr bool _hasThreadFlip(...) { return false; }
+		template<typename T>
+		static auto _setThreadFlip(const T tFlag) -> decltype(stbi_set_flip_vertically_on_load_thread(tFlag), void()) {
+			stbi_set_flip_vertically_on_load_thread(tFlag);
+		}
+		static void _setThreadFlip(...) { }
+
+		std::unordered_map<std::string, std::weak_ptr<CachedTexture>> mEntries;
+		TextureCacheStats mStats;
+
+		/* Decoding */
+		std::vector<std::thread> mThreads;
+		std::deque<Job> mJobs;
+		std::deque<Decoded> mDecoded;
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		bool mQuit = false;
+	};
+}
+
+#endif // !FS_UI_TEXTURE_CACHE
@@ -0,0 +1,295 @@
+// Decode throughput suite for every audio backend, with JSON output for tracking regressions.
+//
+// Usage: fsoal_bench_decode [options] [file...]
+//   -n <runs>      timed runs per case, the best one is reported (default 5)
+//   -o <path>      write JSON there instead of stdout
+//   -d <dir>       where fixtures are generated (default fsoal_bench_fixtures)
+//   -t <s,s,...>   fixture durations in seconds (default 1,10,60)
+//   --simd         repeat MP3/FLAC cases for every instruction set variant the CPU supports
+//   --no-cold      skip cold page cache cases
+// Given files are benchmarked instead of the generated fixtures.
+//
+// Every fixture is decoded from file and from memory, to s16 and to f32.
+// File input is timed with warm page cache and, where the OS lets us drop it, cold.
+// Memory input times decoding only, the file is read beforehand.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+	#include <fcntl.h>
+	#include <unistd.h>
+	#define FSOAL_BENCH_COLD_CACHE
+#endif
+
+#include "../include/decoder.hpp"
+#include "fixtures.hpp"
+
+using namespace FSOAL;
+
+struct Fixture {
+	std::string name, path, encoder;
+	unsigned int channels = 0, sampleRate = 0, bits = 0;
+	double duration = 0;
+};
+
+struct Options {
+	int runs = 5;
+	std::string output, directory = "fsoal_bench_fixtures";
+	std::vector<double> durations{ 1, 10, 60 };
+	std::vector<std::string> files;
+	bool simd = false, cold = true;
+};
+
+static const char* loaderName(AudioFormat tFormat) {
+	switch(tFormat) {
+	case AF_WAV: return "dr_wav";
+	case AF_MP3: return "dr_mp3";
+	case AF_FLAC: return "dr_flac";
+	case AF_VORBIS: return "stb_vorbis";
+	case AF_OPUS: return "opusfile";
+	default: return "unknown";
+	}
+}
+
+static std::string jsonString(const std::string& tValue) {
+	std::string out = "\"";
+	for(char c : tValue) {
+		if(c == '"' || c == '\\') out += '\\';
+		if(static_cast<unsigned char>(c) < 0x20) { out += ' '; continue; }
+		out += c;
+	}
+	return out + "\"";
+}
+
+static bool readFile(const std::string& tPath, std::vector<uint8_t>& tOut) {
+	FILE* file = fopen(tPath.c_str(), "rb");
+	if(!file) return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	tOut.resize(size > 0 ? static_cast<size_t>(size) : 0);
+	bool ok = fread(tOut.data(), 1, tOut.size(), file) == tOut.size();
+	fclose(file);
+	return ok;
+}
+
+// Asks the OS to forget cached pages of the file. Returns false if it can't.
+static bool dropPageCache(const std::string& tPath) {
+#ifdef FSOAL_BENCH_COLD_CACHE
+	int fd = ::open(tPath.c_str(), O_RDONLY);
+	if(fd < 0) return false;
+	// Dirty pages can't be dropped, make sure nothing is waiting for writeback.
+	fsync(fd);
+	bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	::close(fd);
+	return ok;
+#else
+	(void)tPath;
+	return false;
+#endif
+}
+
+static std::vector<Fixture> generateFixtures(const Options& tOptions, std::vector<std::string>& tSkipped) {
+	std::vector<Fixture> fixtures;
+	std::filesystem::create_directories(tOptions.directory);
+	const unsigned int rate = 44100;
+	bool lame = Bench::hasLame();
+	for(double duration : tOptions.durations) {
+		std::string suffix = "_" + std::to_string(static_cast<int>(duration)) + "s";
+		auto add = [&](const std::string& tName, const std::string& tExt, unsigned int tChannels, unsigned int tBits, const std::string& tEncoder) -> Fixture& {
+			Fixture f;
+			f.name = tName + suffix;
+			f.path = (std::filesystem::path(tOptions.directory) / (f.name + tExt)).string();
+			f.encoder = tEncoder;
+			f.channels = tChannels;
+			f.sampleRate = rate;
+			f.bits = tBits;
+			f.duration = duration;
+			fixtures.push_back(f);
+			return fixtures.back();
+		};
+		for(unsigned int channels = 1; channels <= 2; channels++) {
+			const char* layout = channels == 1 ? "mono" : "stereo";
+			for(unsigned int bits : { 8u, 16u, 24u }) {
+				Fixture& f = add(std::string("wav_") + layout + "_" + std::to_string(bits), ".wav", channels, bits, "pcm");
+				Bench::writeWav(f.path, Bench::makeSignal(duration, channels, rate, bits), channels, rate, bits);
+			}
+		}
+		std::vector<int32_t> stereo16 = Bench::makeSignal(duration, 2, rate, 16);
+		for(int level : { 0, 5, 8 }) {
+			Fixture& f = add("flac_stereo_16_l" + std::to_string(level), ".flac", 2, 16, "fixed-predictor level " + std::to_string(level));
+			Bench::FlacWriter::write(f.path, stereo16, 2, rate, 16, level);
+		}
+		{
+			Fixture& f = add("flac_mono_16_l5", ".flac", 1, 16, "fixed-predictor level 5");
+			Bench::FlacWriter::write(f.path, Bench::makeSignal(duration, 1, rate, 16), 1, rate, 16, 5);
+		}
+		{
+			Fixture& f = add("flac_stereo_24_l5", ".flac", 2, 24, "fixed-predictor level 5");
+			Bench::FlacWriter::write(f.path, Bench::makeSignal(duration, 2, rate, 24), 2, rate, 24, 5);
+		}
+		if(!lame) {
+			tSkipped.push_back("mp3_cbr_128" + suffix + ": lame not found on PATH");
+			tSkipped.push_back("mp3_vbr_v2" + suffix + ": lame not found on PATH");
+			continue;
+		}
+		std::string source = (std::filesystem::path(tOptions.directory) / ("wav_stereo_16" + suffix + ".wav")).string();
+		struct { const char* name; const char* mode; } modes[] = { { "mp3_cbr_128", "-b 128 --cbr" }, { "mp3_vbr_v2", "-V 2" } };
+		for(auto& mode : modes) {
+			Fixture& f = add(mode.name, ".mp3", 2, 16, std::string("lame ") + mode.mode);
+			if(!Bench::encodeMp3(source, f.path, mode.mode)) {
+				tSkipped.push_back(f.name + ": lame failed");
+				fixtures.pop_back();
+			}
+		}
+	}
+	return fixtures;
+}
+
+struct Result {
+	double seconds = 1e30;
+	uint64_t frames = 0;
+	AudioFormat format = AF_UNKNOWN;
+	unsigned short channels = 0;
+	bool ok = false;
+};
+
+// Decodes the whole fixture tRuns times, keeps the fastest run.
+static Result measure(const Fixture& tFixture, const std::vector<uint8_t>& tData, bool tMemory, bool tFloat, bool tCold, int tRuns) {
+	Result result;
+	std::vector<int16_t> s16;
+	std::vector<float> f32;
+	for(int r = 0; r < tRuns; r++) {
+		if(tCold && !dropPageCache(tFixture.path)) return result;
+		auto start = std::chrono::steady_clock::now();
+		Decoder decoder;
+		bool opened = tMemory ? decoder.openMemory(tData.data(), tData.size()) : decoder.open(tFixture.path);
+		if(!opened) return result;
+		uint64_t frames = tFloat ? decoder.readAll(f32) : decoder.readAll(s16);
+		auto end = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+		if(seconds < result.seconds) result.seconds = seconds;
+		result.frames = frames;
+		result.format = decoder.getFormat();
+		result.channels = decoder.getChannels();
+		result.ok = true;
+	}
+	return result;
+}
+
+static bool parseOptions(int argc, char** argv, Options& tOptions) {
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if(arg == "-n" && hasValue) tOptions.runs = std::max(1, atoi(argv[++i]));
+		else if(arg == "-o" && hasValue) tOptions.output = argv[++i];
+		else if(arg == "-d" && hasValue) tOptions.directory = argv[++i];
+		else if(arg == "-t" && hasValue) {
+			tOptions.durations.clear();
+			for(char* p = argv[++i]; *p;) {
+				char* end = p;
+				double seconds = strtod(p, &end);
+				if(end == p) return false;
+				if(seconds > 0) tOptions.durations.push_back(seconds);
+				p = *end == ',' ? end + 1 : end;
+			}
+		}
+		else if(arg == "--simd") tOptions.simd = true;
+		else if(arg == "--no-cold") tOptions.cold = false;
+		else if(!arg.empty() && arg[0] == '-') return false;
+		else tOptions.files.push_back(arg);
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if(!parseOptions(argc, argv, options)) {
+		fprintf(stderr, "usage: %s [-n runs] [-o out.json] [-d dir] [-t 1,10,60] [--simd] [--no-cold] [file...]\n", argv[0]);
+		return 1;
+	}
+	std::vector<std::string> skipped;
+	std::vector<Fixture> fixtures;
+	if(options.files.empty()) fixtures = generateFixtures(options, skipped);
+	else for(const std::string& file : options.files) {
+		Fixture f;
+		f.name = std::filesystem::path(file).filename().string();
+		f.path = file;
+		f.encoder = "external";
+		fixtures.push_back(f);
+	}
+#ifdef FSOAL_BENCH_COLD_CACHE
+	bool cold = options.cold;
+#else
+	bool cold = false;
+	if(options.cold) skipped.push_back("cold page cache: not supported on this platform");
+#endif
+
+	std::string json = "{\n\t\"benchmark\": \"fsoal_decode\",\n\t\"schema\": 1,\n";
+	json += "\t\"simd_support\": " + jsonString(getDecoderSimdName(getDecoderSimdSupport())) + ",\n";
+	json += "\t\"runs\": " + std::to_string(options.runs) + ",\n\t\"results\": [";
+	bool first = true;
+	DecoderSimd support = getDecoderSimdSupport();
+	for(const Fixture& fixture : fixtures) {
+		std::vector<uint8_t> data;
+		if(!readFile(fixture.path, data)) {
+			skipped.push_back(fixture.name + ": couldn't read " + fixture.path);
+			continue;
+		}
+		int lowest = options.simd && support != DS_NONE ? DS_SSE2 : support;
+		for(int level = lowest; level <= support; level++) {
+			DecoderSimd simd = setDecoderSimd(static_cast<DecoderSimd>(level));
+			AudioFormat format = AF_UNKNOWN;
+			for(int memory = 0; memory < 2; memory++)
+				for(int f32 = 0; f32 < 2; f32++)
+					for(int coldRun = 0; coldRun < (memory || !cold ? 1 : 2); coldRun++) {
+						// Warm up page cache and the allocator before warm runs.
+						if(!coldRun) measure(fixture, data, memory != 0, f32 != 0, false, 1);
+						Result r = measure(fixture, data, memory != 0, f32 != 0, coldRun != 0, options.runs);
+						if(!r.ok) {
+							skipped.push_back(fixture.name + (coldRun ? ": couldn't drop page cache or decode" : ": couldn't decode"));
+							continue;
+						}
+						format = r.format;
+						double outputBytes = static_cast<double>(r.frames) * r.channels * (f32 ? 4 : 2);
+						char line[768];
+						snprintf(line, sizeof(line),
+							"%s\n\t\t{ \"fixture\": %s, \"loader\": \"%s\", \"encoder\": %s, \"channels\": %u, \"bits\": %u, "
+							"\"duration\": %.3f, \"bytes\": %zu, \"simd\": \"%s\", \"input\": \"%s\", \"output\": \"%s\", \"cache\": \"%s\", "
+							"\"frames\": %llu, \"seconds\": %.6f, \"frames_per_s\": %.0f, \"input_mb_s\": %.2f, \"output_mb_s\": %.2f }",
+							first ? "" : ",", jsonString(fixture.name).c_str(), loaderName(r.format), jsonString(fixture.encoder).c_str(),
+							static_cast<unsigned int>(r.channels), fixture.bits, fixture.duration, data.size(), getDecoderSimdName(simd),
+							memory ? "memory" : "file", f32 ? "f32" : "s16", memory ? "none" : (coldRun ? "cold" : "warm"),
+							static_cast<unsigned long long>(r.frames), r.seconds, r.frames / r.seconds,
+							data.size() / r.seconds / 1e6, outputBytes / r.seconds / 1e6);
+						json += line;
+						first = false;
+					}
+			// Only MP3 and FLAC have per instruction set variants.
+			if(format != AF_MP3 && format != AF_FLAC) break;
+		}
+	}
+	setDecoderSimd(support);
+	json += "\n\t],\n\t\"skipped\": [";
+	for(size_t i = 0; i < skipped.size(); i++) json += (i ? ", " : "") + jsonString(skipped[i]);
+	json += "]\n}\n";
+
+	if(options.output.empty()) fputs(json.c_str(), stdout);
+	else {
+		FILE* file = fopen(options.output.c_str(), "wb");
+		if(!file) {
+			fprintf(stderr, "couldn't write %s\n", options.output.c_str());
+			return 1;
+		}
+		fputs(json.c_str(), file);
+		fclose(file);
+	}
+	return 0;
+}
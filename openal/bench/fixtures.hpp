@@ -0,0 +1,97 @@
+#ifndef FS_OAL_BENCH_FIXTURES
+#define FS_OAL_BENCH_FIXTURES
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "flac_writer.hpp"
+
+// Synthetic audio for decode benchmarks.
+// Everything is generated from a fixed seed, so fixtures are byte-identical between runs and machines.
+
+namespace FSOAL {
+namespace Bench {
+
+	// Music-like signal: a few detuned partials with slow vibrato and tremolo plus a little noise,
+	// so predictors and entropy coders see something between a pure tone and white noise.
+	// Returns interleaved samples scaled to tBits (8, 16 or 24).
+	static std::vector<int32_t> makeSignal(double tSeconds, unsigned int tChannels, unsigned int tSampleRate, unsigned int tBits) {
+		const double pi = 3.14159265358979323846;
+		size_t frames = static_cast<size_t>(tSeconds * tSampleRate);
+		std::vector<int32_t> out(frames * tChannels);
+		double amplitude = static_cast<double>((1 << (tBits - 1)) - 1) * 0.5;
+		uint32_t seed = 0x2545F491u;
+		for(size_t i = 0; i < frames; i++) {
+			double t = static_cast<double>(i) / tSampleRate;
+			double vibrato = std::sin(2 * pi * 5.0 * t) * 0.004;
+			double tremolo = 0.75 + 0.25 * std::sin(2 * pi * 0.3 * t);
+			for(unsigned int c = 0; c < tChannels; c++) {
+				double detune = 1.0 + 0.002 * c;
+				double v = 0.5 * std::sin(2 * pi * 220.0 * detune * t * (1 + vibrato))
+					+ 0.25 * std::sin(2 * pi * 440.0 * detune * t + 0.5)
+					+ 0.15 * std::sin(2 * pi * 661.0 * detune * t + 1.3)
+					+ 0.05 * std::sin(2 * pi * 1323.0 * t);
+				seed ^= seed << 13;
+				seed ^= seed >> 17;
+				seed ^= seed << 5;
+				v = v * tremolo + (static_cast<double>(seed) / 4294967296.0 - 0.5) * 0.01;
+				out[i * tChannels + c] = static_cast<int32_t>(std::lround(v * amplitude));
+			}
+		}
+		return out;
+	}
+
+	// Plain PCM WAV. 8-bit samples are stored unsigned, as the format requires.
+	static bool writeWav(const std::string& tPath, const std::vector<int32_t>& tSamples, unsigned int tChannels,
+		unsigned int tSampleRate, unsigned int tBits) {
+		FILE* file = fopen(tPath.c_str(), "wb");
+		if(!file) return false;
+		unsigned int bytes = tBits / 8;
+		uint32_t dataSize = static_cast<uint32_t>(tSamples.size() * bytes);
+		auto u32 = [file](uint32_t v) { uint8_t b[4] = { uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24) }; fwrite(b, 1, 4, file); };
+		auto u16 = [file](uint16_t v) { uint8_t b[2] = { uint8_t(v), uint8_t(v >> 8) }; fwrite(b, 1, 2, file); };
+		fwrite("RIFF", 1, 4, file);
+		u32(36 + dataSize);
+		fwrite("WAVEfmt ", 1, 8, file);
+		u32(16);
+		u16(1);
+		u16(static_cast<uint16_t>(tChannels));
+		u32(tSampleRate);
+		u32(tSampleRate * tChannels * bytes);
+		u16(static_cast<uint16_t>(tChannels * bytes));
+		u16(static_cast<uint16_t>(tBits));
+		fwrite("data", 1, 4, file);
+		u32(dataSize);
+		std::vector<uint8_t> data(dataSize);
+		for(size_t i = 0; i < tSamples.size(); i++) {
+			int32_t v = tSamples[i];
+			if(bytes == 1) data[i] = static_cast<uint8_t>(v + 128);
+			else for(unsigned int b = 0; b < bytes; b++) data[i * bytes + b] = static_cast<uint8_t>(v >> (8 * b));
+		}
+		bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+		fclose(file);
+		return ok;
+	}
+
+	// There is no MP3 encoder in the tree, so MP3 fixtures come from LAME when it is on PATH.
+	static bool hasLame() {
+#ifdef _WIN32
+		return system("lame --version > NUL 2>&1") == 0;
+#else
+		return system("lame --version > /dev/null 2>&1") == 0;
+#endif
+	}
+	// tMode is LAME arguments selecting bitrate, e.g. "-b 128 --cbr" or "-V 2".
+	static bool encodeMp3(const std::string& tWav, const std::string& tMp3, const std::string& tMode) {
+		std::string command = "lame --quiet " + tMode + " \"" + tWav + "\" \"" + tMp3 + "\"";
+		return system(command.c_str()) == 0;
+	}
+
+}
+}
+
+#endif // !FS_OAL_BENCH_FIXTURES
@@ -0,0 +1,275 @@
+#ifndef FS_OAL_BENCH_FLAC_WRITER
+#define FS_OAL_BENCH_FLAC_WRITER
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <string>
+
+// Minimal FLAC encoder for benchmark fixtures, there is no encoder in dr_libs.
+// Uses fixed predictors and partitioned Rice coding only (no LPC). dr_flac decodes those through
+// the same residual loops as LPC subframes. Effort levels loosely follow flac's -0/-5/-8:
+//   0 - independent channels, fixed order 1, one Rice partition;
+//   5 - best of fixed orders 0..4, best stereo decorrelation, partition orders up to 4;
+//   8 - as 5, partition orders up to 8.
+
+namespace FSOAL {
+namespace Bench {
+
+	class FlacBitWriter {
+	public:
+		void write(uint64_t tValue, unsigned int tBits) {
+			for(unsigned int i = tBits; i-- > 0;) {
+				mCurrent = static_cast<uint8_t>((mCurrent << 1) | ((tValue >> i) & 1));
+				if(++mUsed == 8) { bytes.push_back(mCurrent); mCurrent = 0; mUsed = 0; }
+			}
+		}
+		void writeSigned(int64_t tValue, unsigned int tBits) {
+			write(static_cast<uint64_t>(tValue) & ((tBits >= 64) ? ~0ull : ((1ull << tBits) - 1)), tBits);
+		}
+		void writeUnary(uint32_t tZeros) {
+			while(tZeros >= 32) { write(0, 32); tZeros -= 32; }
+			write(1, tZeros + 1);
+		}
+		void align() { if(mUsed) write(0, 8 - mUsed); }
+
+		std::vector<uint8_t> bytes;
+	private:
+		uint8_t mCurrent = 0;
+		unsigned int mUsed = 0;
+	};
+
+	static uint8_t _flacCrc8(const uint8_t* tData, size_t tSize) {
+		uint8_t crc = 0;
+		for(size_t i = 0; i < tSize; i++) {
+			crc ^= tData[i];
+			for(int b = 0; b < 8; b++) crc = static_cast<uint8_t>((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+		}
+		return crc;
+	}
+	static uint16_t _flacCrc16(const uint8_t* tData, size_t tSize) {
+		uint16_t crc = 0;
+		for(size_t i = 0; i < tSize; i++) {
+			crc ^= static_cast<uint16_t>(tData[i] << 8);
+			for(int b = 0; b < 8; b++) crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+		}
+		return crc;
+	}
+
+	class FlacWriter {
+	public:
+		// tSamples are interleaved, already in range of tBitsPerSample (8, 16 or 24).
+		static bool write(const std::string& tPath, const std::vector<int32_t>& tSamples, unsigned int tChannels,
+			unsigned int tSampleRate, unsigned int tBitsPerSample, int tLevel) {
+			if(tChannels == 0 || tChannels > 8) return false;
+			FlacWriter writer(tChannels, tBitsPerSample, tLevel);
+			uint64_t frames = tSamples.size() / tChannels;
+			FlacBitWriter out;
+			out.write(0x664C6143, 32); // "fLaC"
+			// STREAMINFO, the only (so last) metadata block.
+			out.write(1, 1);
+			out.write(0, 7);
+			out.write(34, 24);
+			out.write(BLOCK_SIZE, 16);
+			out.write(BLOCK_SIZE, 16);
+			out.write(0, 24);
+			out.write(0, 24);
+			out.write(tSampleRate, 20);
+			out.write(tChannels - 1, 3);
+			out.write(tBitsPerSample - 1, 5);
+			out.write(frames, 36);
+			for(int i = 0; i < 16; i++) out.write(0, 8); // no MD5
+			for(uint64_t start = 0, index = 0; start < frames; start += BLOCK_SIZE, index++) {
+				unsigned int count = static_cast<unsigned int>(frames - start < BLOCK_SIZE ? frames - start : BLOCK_SIZE);
+				writer._frame(out, tSamples.data() + start * tChannels, count, index);
+			}
+			FILE* file = fopen(tPath.c_str(), "wb");
+			if(!file) return false;
+			bool ok = fwrite(out.bytes.data(), 1, out.bytes.size(), file) == out.bytes.size();
+			fclose(file);
+			return ok;
+		}
+
+	private:
+		static const unsigned int BLOCK_SIZE = 4096;
+
+		FlacWriter(unsigned int tChannels, unsigned int tBits, int tLevel)
+			: mChannels(tChannels), mBits(tBits), mLevel(tLevel) { }
+
+		void _frame(FlacBitWriter& tOut, const int32_t* tSamples, unsigned int tCount, uint64_t tIndex) {
+			size_t begin = tOut.bytes.size();
+			// Split channels, stereo also gets its side/mid variants.
+			std::vector<std::vector<int64_t>> ch(mChannels, std::vector<int64_t>(tCount));
+			for(unsigned int i = 0; i < tCount; i++)
+				for(unsigned int c = 0; c < mChannels; c++) ch[c][i] = tSamples[i * mChannels + c];
+			unsigned int assignment = mChannels - 1;
+			std::vector<SubframeChoice> choice(mChannels);
+			for(unsigned int c = 0; c < mChannels; c++) choice[c] = _choose(ch[c], mBits);
+			std::vector<int64_t> side, mid;
+			SubframeChoice sideChoice, midChoice;
+			if(mChannels == 2 && mLevel > 0) {
+				side.resize(tCount);
+				mid.resize(tCount);
+				for(unsigned int i = 0; i < tCount; i++) {
+					side[i] = ch[0][i] - ch[1][i];
+					mid[i] = (ch[0][i] + ch[1][i]) >> 1;
+				}
+				sideChoice = _choose(side, mBits + 1);
+				midChoice = _choose(mid, mBits);
+				uint64_t costs[4] = { choice[0].bits + choice[1].bits, choice[0].bits + sideChoice.bits,
+					sideChoice.bits + choice[1].bits, midChoice.bits + sideChoice.bits };
+				int best = 0;
+				for(int i = 1; i < 4; i++) if(costs[i] < costs[best]) best = i;
+				if(best == 1) { assignment = 8; ch[1] = side; choice[1] = sideChoice; }
+				else if(best == 2) { assignment = 9; ch[0] = side; choice[0] = sideChoice; }
+				else if(best == 3) { assignment = 10; ch[0] = mid; choice[0] = midChoice; ch[1] = side; choice[1] = sideChoice; }
+			}
+			// Header.
+			tOut.write(0x3FFE, 14);
+			tOut.write(0, 1);
+			tOut.write(0, 1); // fixed block size
+			tOut.write(tCount == BLOCK_SIZE ? 12 : 7, 4);
+			tOut.write(0, 4); // sample rate from STREAMINFO
+			tOut.write(assignment, 4);
+			tOut.write(mBits == 8 ? 1 : (mBits == 16 ? 4 : 6), 3);
+			tOut.write(0, 1);
+			_utf8(tOut, tIndex);
+			if(tCount != BLOCK_SIZE) tOut.write(tCount - 1, 16);
+			tOut.write(_flacCrc8(tOut.bytes.data() + begin, tOut.bytes.size() - begin), 8);
+			// Subframes.
+			for(unsigned int c = 0; c < mChannels; c++) {
+				bool isSide = (assignment == 8 && c == 1) || (assignment == 9 && c == 0) || (assignment == 10 && c == 1);
+				_subframe(tOut, ch[c], choice[c], mBits + (isSide ? 1 : 0));
+			}
+			tOut.align();
+			tOut.write(_flacCrc16(tOut.bytes.data() + begin, tOut.bytes.size() - begin), 16);
+		}
+
+		struct SubframeChoice {
+			int type = 0; // 0 - constant, 1 - verbatim, 2 - fixed
+			unsigned int order = 0;
+			unsigned int partitionOrder = 0;
+			std::vector<unsigned int> params;
+			uint64_t bits = ~0ull;
+		};
+
+		static void _residual(const std::vector<int64_t>& tIn, unsigned int tOrder, std::vector<uint32_t>& tOut) {
+			size_t n = tIn.size();
+			tOut.resize(n > tOrder ? n - tOrder : 0);
+			for(size_t i = tOrder; i < n; i++) {
+				int64_t r;
+				switch(tOrder) {
+				case 0: r = tIn[i]; break;
+				case 1: r = tIn[i] - tIn[i - 1]; break;
+				case 2: r = tIn[i] - 2 * tIn[i - 1] + tIn[i - 2]; break;
+				case 3: r = tIn[i] - 3 * tIn[i - 1] + 3 * tIn[i - 2] - tIn[i - 3]; break;
+				default: r = tIn[i] - 4 * tIn[i - 1] + 6 * tIn[i - 2] - 4 * tIn[i - 3] + tIn[i - 4]; break;
+				}
+				int32_t s = static_cast<int32_t>(r);
+				tOut[i - tOrder] = (static_cast<uint32_t>(s) << 1) ^ static_cast<uint32_t>(s >> 31);
+			}
+		}
+		// Cheapest Rice parameter for given zigzagged values, returns bit count.
+		static uint64_t _riceCost(const uint32_t* tValues, size_t tCount, unsigned int& tParam) {
+			uint64_t sum = 0;
+			for(size_t i = 0; i < tCount; i++) sum += tValues[i];
+			unsigned int guess = 0;
+			uint64_t mean = tCount ? sum / tCount : 0;
+			while(guess < 30 && (1ull << (guess + 1)) <= mean + 1) guess++;
+			uint64_t best = ~0ull;
+			for(unsigned int k = guess > 0 ? guess - 1 : 0; k <= guess + 1 && k <= 30; k++) {
+				uint64_t bits = static_cast<uint64_t>(tCount) * (k + 1);
+				for(size_t i = 0; i < tCount; i++) bits += tValues[i] >> k;
+				if(bits < best) { best = bits; tParam = k; }
+			}
+			return best + 5;
+		}
+		SubframeChoice _choose(const std::vector<int64_t>& tIn, unsigned int tBits) {
+			SubframeChoice best;
+			size_t n = tIn.size();
+			bool constant = true;
+			for(size_t i = 1; i < n && constant; i++) constant = tIn[i] == tIn[0];
+			if(constant) {
+				best.type = 0;
+				best.bits = 8 + tBits;
+				return best;
+			}
+			best.type = 1;
+			best.bits = 8 + static_cast<uint64_t>(n) * tBits;
+			unsigned int minOrder = mLevel > 0 ? 0 : 1, maxOrder = mLevel > 0 ? 4 : 1;
+			unsigned int maxPartition = mLevel >= 8 ? 8 : (mLevel > 0 ? 4 : 0);
+			std::vector<uint32_t> residual;
+			for(unsigned int order = minOrder; order <= maxOrder && order < n; order++) {
+				_residual(tIn, order, residual);
+				for(unsigned int p = 0; p <= maxPartition; p++) {
+					size_t parts = static_cast<size_t>(1) << p;
+					if(n % parts || n / parts <= order) break;
+					SubframeChoice c;
+					c.type = 2;
+					c.order = order;
+					c.partitionOrder = p;
+					c.bits = 8 + static_cast<uint64_t>(order) * tBits + 6;
+					size_t offset = 0;
+					for(size_t part = 0; part < parts; part++) {
+						size_t count = n / parts - (part == 0 ? order : 0);
+						unsigned int k = 0;
+						c.bits += _riceCost(residual.data() + offset, count, k);
+						c.params.push_back(k);
+						offset += count;
+					}
+					if(c.bits < best.bits) best = c;
+				}
+			}
+			return best;
+		}
+		void _subframe(FlacBitWriter& tOut, const std::vector<int64_t>& tIn, const SubframeChoice& tChoice, unsigned int tBits) {
+			tOut.write(0, 1);
+			if(tChoice.type == 0) {
+				tOut.write(0, 6);
+				tOut.write(0, 1);
+				tOut.writeSigned(tIn[0], tBits);
+				return;
+			}
+			if(tChoice.type == 1) {
+				tOut.write(1, 6);
+				tOut.write(0, 1);
+				for(int64_t v : tIn) tOut.writeSigned(v, tBits);
+				return;
+			}
+			tOut.write(8 | tChoice.order, 6);
+			tOut.write(0, 1);
+			for(unsigned int i = 0; i < tChoice.order; i++) tOut.writeSigned(tIn[i], tBits);
+			std::vector<uint32_t> residual;
+			_residual(tIn, tChoice.order, residual);
+			tOut.write(1, 2); // Rice with 5-bit parameters
+			tOut.write(tChoice.partitionOrder, 4);
+			size_t parts = static_cast<size_t>(1) << tChoice.partitionOrder, offset = 0;
+			for(size_t part = 0; part < parts; part++) {
+				size_t count = tIn.size() / parts - (part == 0 ? tChoice.order : 0);
+				unsigned int k = tChoice.params[part];
+				tOut.write(k, 5);
+				for(size_t i = 0; i < count; i++) {
+					uint32_t v = residual[offset + i];
+					tOut.writeUnary(v >> k);
+					if(k) tOut.write(v & ((1u << k) - 1), k);
+				}
+				offset += count;
+			}
+		}
+		static void _utf8(FlacBitWriter& tOut, uint64_t tValue) {
+			if(tValue < 0x80) { tOut.write(tValue, 8); return; }
+			int bytes = 2;
+			while(bytes < 7 && tValue >= (1ull << (5 * bytes + 1))) bytes++;
+			tOut.write(((0xFF00u >> bytes) & 0xFF) | (tValue >> (6 * (bytes - 1))), 8);
+			for(int i = bytes - 2; i >= 0; i--) tOut.write(0x80 | ((tValue >> (6 * i)) & 0x3F), 8);
+		}
+
+		unsigned int mChannels, mBits;
+		int mLevel;
+	};
+
+}
+}
+
+#endif // !FS_OAL_BENCH_FLAC_WRITER
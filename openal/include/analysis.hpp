@@ -0,0 +1,272 @@
+#ifndef FS_OAL_ANALYSIS
+#define FS_OAL_ANALYSIS
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "defenitions.hpp"
+#include "source.hpp"
+#include "stream.hpp"
+#include "worker.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define FSOAL_ANALYSIS_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace FSOAL {
+
+	// In-place complex FFT of power of two size (split real/imaginary arrays).
+	// First two passes are done as one radix-4 pass, the rest are radix-2 passes
+	// running four butterflies at once with SSE2.
+	class FFT {
+	public:
+		FFT(unsigned int tSize = 1024) { resize(tSize); }
+
+		void resize(unsigned int tSize) {
+			unsigned int bits = 2;
+			while((1u << bits) < tSize) bits++;
+			mSize = 1u << bits;
+			mReverse.resize(mSize);
+			for(unsigned int i = 0; i < mSize; i++) {
+				unsigned int r = 0;
+				for(unsigned int b = 0; b < bits; b++) r |= ((i >> b) & 1u) << (bits - 1 - b);
+				mReverse[i] = r;
+			}
+			// Twiddles of every radix-2 pass lie one after another, so a pass reads them linearly.
+			mTwiddleRe.clear();
+			mTwiddleIm.clear();
+			for(unsigned int len = 8; len <= mSize; len <<= 1)
+				for(unsigned int k = 0; k < len / 2; k++) {
+					double angle = -2.0 * 3.14159265358979323846 * k / len;
+					mTwiddleRe.push_back(static_cast<float>(std::cos(angle)));
+					mTwiddleIm.push_back(static_cast<float>(std::sin(angle)));
+				}
+		}
+		unsigned int getSize() const { return mSize; }
+		// Position an input sample has to be put at before transform().
+		unsigned int reverse(unsigned int tIndex) const { return mReverse[tIndex]; }
+
+		// Transforms bit reversed input (see reverse()) into natural order spectrum.
+		void transform(float* tRe, float* tIm) const {
+			for(unsigned int i = 0; i < mSize; i += 4) {
+				float aRe = tRe[i] + tRe[i + 1], aIm = tIm[i] + tIm[i + 1];
+				float bRe = tRe[i] - tRe[i + 1], bIm = tIm[i] - tIm[i + 1];
+				float cRe = tRe[i + 2] + tRe[i + 3], cIm = tIm[i + 2] + tIm[i + 3];
+				float dRe = tRe[i + 2] - tRe[i + 3], dIm = tIm[i + 2] - tIm[i + 3];
+				tRe[i] = aRe + cRe; tIm[i] = aIm + cIm;
+				tRe[i + 2] = aRe - cRe; tIm[i + 2] = aIm - cIm;
+				// Multiplying by -j swaps parts and flips a sign.
+				tRe[i + 1] = bRe + dIm; tIm[i + 1] = bIm - dRe;
+				tRe[i + 3] = bRe - dIm; tIm[i + 3] = bIm + dRe;
+			}
+			const float* twRe = mTwiddleRe.data();
+			const float* twIm = mTwiddleIm.data();
+			for(unsigned int len = 8; len <= mSize; len <<= 1) {
+				unsigned int half = len / 2;
+				for(unsigned int start = 0; start < mSize; start += len) {
+					float* aRe = tRe + start; float* aIm = tIm + start;
+					float* bRe = aRe + half; float* bIm = aIm + half;
+					unsigned int k = 0;
+#ifdef FSOAL_ANALYSIS_SSE2
+					for(; k + 4 <= half; k += 4) {
+						__m128 wr = _mm_loadu_ps(twRe + k), wi = _mm_loadu_ps(twIm + k);
+						__m128 br = _mm_loadu_ps(bRe + k), bi = _mm_loadu_ps(bIm + k);
+						__m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+						__m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+						__m128 ar = _mm_loadu_ps(aRe + k), ai = _mm_loadu_ps(aIm + k);
+						_mm_storeu_ps(aRe + k, _mm_add_ps(ar, tr));
+						_mm_storeu_ps(aIm + k, _mm_add_ps(ai, ti));
+						_mm_storeu_ps(bRe + k, _mm_sub_ps(ar, tr));
+						_mm_storeu_ps(bIm + k, _mm_sub_ps(ai, ti));
+					}
+#endif
+					for(; k < half; k++) {
+						float tr = bRe[k] * twRe[k] - bIm[k] * twIm[k];
+						float ti = bRe[k] * twIm[k] + bIm[k] * twRe[k];
+						bRe[k] = aRe[k] - tr; bIm[k] = aIm[k] - ti;
+						aRe[k] += tr; aIm[k] += ti;
+					}
+				}
+				twRe += half;
+				twIm += half;
+			}
+		}
+	private:
+		unsigned int mSize = 0;
+		std::vector<unsigned int> mReverse;
+		std::vector<float> mTwiddleRe, mTwiddleIm;
+	};
+
+	// Levels and spectrum of a moment of playback.
+	struct AnalysisFrame {
+		// Count of frames published so far (0 means nothing is analyzed yet).
+		uint64_t sequence = 0;
+		// Of mono mix, in [0;1].
+		float rms = 0, peak = 0;
+		// Sine amplitude in every band, bands are spaced logarithmically from 20 Hz to Nyquist.
+		std::vector<float> bands;
+	};
+
+	// Spectrum and level meter for one playing source or stream.
+	// Every update() takes the window of samples the source plays right now (from cached PCM of the clip
+	// or from chunks queued in the stream) and analyzes it on a worker thread.
+	// At most one FFT (of up to 1024 points) runs per tap at a time, so cost per frame is bounded:
+	// if previous window isn't done yet, update() does nothing.
+	class AnalysisTap {
+	public:
+		AnalysisTap(unsigned int tBands = 32, unsigned int tFftSize = 1024)
+			: mBandCount(tBands ? tBands : 1) {
+			if(tFftSize > 1024) tFftSize = 1024;
+			mFFT.resize(tFftSize);
+			unsigned int size = mFFT.getSize();
+			mInput.assign(size, 0);
+			mRe.assign(size, 0);
+			mIm.assign(size, 0);
+			mWindow.resize(size);
+			// Hann window.
+			for(unsigned int i = 0; i < size; i++)
+				mWindow[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * 3.14159265358979323846 * i / size));
+			for(AnalysisFrame& frame : mFrames) frame.bands.assign(mBandCount, 0);
+		}
+		~AnalysisTap() { mGroup.wait(); }
+		AnalysisTap(const AnalysisTap&) = delete;
+		AnalysisTap& operator=(const AnalysisTap&) = delete;
+
+		// Source (or stream) must outlive the tap or be detached first.
+		AnalysisTap* attach(const Source* tSource) {
+			mGroup.wait();
+			mSource = tSource;
+			mStream = nullptr;
+			return this;
+		}
+		AnalysisTap* attach(const Stream* tStream) {
+			mGroup.wait();
+			mSource = nullptr;
+			mStream = tStream;
+			return this;
+		}
+		AnalysisTap* detach() {
+			mGroup.wait();
+			mSource = nullptr;
+			mStream = nullptr;
+			return this;
+		}
+
+		// Call once per frame, on the thread that plays the source.
+		void update() {
+			if(!oalGlobalInitState || !mGroup.isDone()) return;
+			if(mSource && mSource->isInitialized() && mSource->isPlaying() && mSource->getClip()) {
+				std::shared_ptr<Clip> clip = mSource->getClip();
+				uint64_t offset = static_cast<uint64_t>(mSource->getOffsetInSamples());
+				mGroup.run([this, clip, offset]() {
+					// Reads (or decodes, first time) samples on the worker, not to stall the game.
+					std::shared_ptr<const std::vector<int16_t>> pcm = clip->getPcm();
+					if(!pcm) return;
+					_gather(*pcm, clip->getChannels(), offset);
+					_analyze(clip->getSampleRate());
+				});
+			}
+			else if(mStream && mStream->isPlaying()) {
+				unsigned int rate = 0;
+				size_t read = mStream->peek(mInput.data(), mInput.size(), &rate);
+				if(read == 0) return;
+				std::fill(mInput.begin() + read, mInput.end(), 0.f);
+				mGroup.run([this, rate]() { _analyze(rate); });
+			}
+			else if(mFrames[_front()].peak != 0) {
+				// Nothing plays: fall to silence once.
+				std::fill(mInput.begin(), mInput.end(), 0.f);
+				_analyze(mRate);
+			}
+		}
+
+		// Latest published result. Stays valid until the next update() call.
+		const AnalysisFrame& get() const { return mFrames[_front()]; }
+		unsigned int getBandCount() const { return mBandCount; }
+		unsigned int getFftSize() const { return mFFT.getSize(); }
+		// Frequency range of given band, in Hz (for last analyzed sample rate).
+		float getBandLow(unsigned int tBand) const { return _bandEdge(tBand, mRate); }
+		float getBandHigh(unsigned int tBand) const { return _bandEdge(tBand + 1, mRate); }
+
+	private:
+		unsigned int _front() const { return mFront.load(std::memory_order_acquire); }
+		float _bandEdge(unsigned int tBand, unsigned int tRate) const {
+			float nyquist = tRate / 2.f;
+			if(nyquist <= 20.f) return 0;
+			return 20.f * std::pow(nyquist / 20.f, static_cast<float>(tBand) / mBandCount);
+		}
+
+		// Mono mix of the window starting at tOffset (zero padded after the end of the clip).
+		void _gather(const std::vector<int16_t>& tPcm, unsigned short tChannels, uint64_t tOffset) {
+			if(!tChannels) tChannels = 1;
+			uint64_t frames = tPcm.size() / tChannels;
+			float scale = 1.f / (32768.f * tChannels);
+			for(size_t i = 0; i < mInput.size(); i++) {
+				uint64_t f = tOffset + i;
+				if(f >= frames) { mInput[i] = 0; continue; }
+				int sum = 0;
+				for(unsigned short c = 0; c < tChannels; c++) sum += tPcm[f * tChannels + c];
+				mInput[i] = sum * scale;
+			}
+		}
+		// Runs on a worker. Writes into the back frame and publishes it.
+		void _analyze(unsigned int tRate) {
+			unsigned int size = mFFT.getSize();
+			AnalysisFrame& frame = mFrames[1 - _front()];
+			float sum = 0, peak = 0;
+			for(unsigned int i = 0; i < size; i++) {
+				float v = mInput[i];
+				sum += v * v;
+				peak = std::max(peak, std::fabs(v));
+				mRe[mFFT.reverse(i)] = v * mWindow[i];
+				mIm[i] = 0;
+			}
+			frame.rms = std::sqrt(sum / size);
+			frame.peak = peak;
+			mFFT.transform(mRe.data(), mIm.data());
+
+			// Hann window halves the amplitude, so a sine of amplitude A peaks at A*N/4.
+			float norm = 4.f / size;
+			float binWidth = tRate ? static_cast<float>(tRate) / size : 1.f;
+			unsigned int bins = size / 2;
+			for(unsigned int b = 0; b < mBandCount; b++) {
+				unsigned int low = static_cast<unsigned int>(_bandEdge(b, tRate) / binWidth);
+				unsigned int high = static_cast<unsigned int>(_bandEdge(b + 1, tRate) / binWidth);
+				if(low < 1) low = 1;
+				if(high > bins) high = bins;
+				if(high <= low) high = std::min(low + 1, bins);
+				// Loudest bin of the band, so a pure tone reads as its amplitude.
+				float band = 0;
+				for(unsigned int k = low; k < high; k++)
+					band = std::max(band, mRe[k] * mRe[k] + mIm[k] * mIm[k]);
+				frame.bands[b] = std::sqrt(band) * norm;
+			}
+			frame.sequence = ++mSequence;
+			mRate = tRate;
+			mFront.store(1 - _front(), std::memory_order_release);
+		}
+
+		unsigned int mBandCount;
+		const Source* mSource = nullptr;
+		const Stream* mStream = nullptr;
+
+		/* Worker side */
+		FFT mFFT;
+		std::vector<float> mInput, mWindow, mRe, mIm;
+		uint64_t mSequence = 0;
+		std::atomic<unsigned int> mRate{0};
+		WorkGroup mGroup;
+
+		/* Double-buffered result */
+		AnalysisFrame mFrames[2];
+		std::atomic<unsigned int> mFront{0};
+	};
+
+}
+
+#endif // !FS_OAL_ANALYSIS
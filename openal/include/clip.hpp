@@ -0,0 +1,157 @@
+#ifndef FS_OAL_CLIP
+#define FS_OAL_CLIP
+
+#include <memory>
+#include <unordered_map>
+#include <filesystem>
+#include <chrono>
+#include <mutex>
+
+#include "defenitions.hpp"
+#include "decoder.hpp"
+
+namespace FSOAL {
+
+	// Decoded audio living in an AL buffer.
+	// Clips are shared: every source loading the same file plays from the same buffer,
+	// which is freed when the last holder lets go of it.
+	class Clip {
+	public:
+		~Clip() {
+			if(oalGlobalInitState && mBuffer) oalDeleteBuffers(1, &mBuffer);
+			FSOAL_STAT(StatsCounters::add(SC_BUFFER_BYTES, -static_cast<int64_t>(mBytes)));
+		}
+
+		// With tKeepPcm decoded samples stay in RAM after upload (see getPcm()).
+		static std::shared_ptr<Clip> load(const std::string& tSrc, bool tKeepPcm = false) {
+			if(!oalGlobalInitState) return nullptr;
+			std::error_code ec;
+			std::string key = std::filesystem::weakly_canonical(tSrc, ec).string();
+			if(ec) key = tSrc;
+			auto& cache = _cache();
+			auto it = cache.find(key);
+			if(it != cache.end())
+				if(auto clip = it->second.lock()) return clip;
+
+			std::shared_ptr<Clip> clip(new Clip());
+			clip->mPath = tSrc;
+			oalGetError(); // clear error code 
+			oalGenBuffers(1, &clip->mBuffer);
+			if(oalGetError() != AL_NO_ERROR) return nullptr;
+			if(!clip->_load(tSrc, tKeepPcm)) {
+				LOG_WARN("Couldn't load unsupported audio format at " + tSrc);
+				return nullptr;
+			}
+			cache[key] = clip;
+			return clip;
+		}
+		// Count of distinct clips currently alive.
+		static size_t getCachedCount() {
+			size_t count = 0;
+			for(auto it = _cache().begin(); it != _cache().end();) {
+				if(it->second.expired()) it = _cache().erase(it);
+				else { count++; it++; }
+			}
+			return count;
+		}
+
+		ALuint getBuffer() const { return mBuffer; }
+		ALenum getFormat() const { return mFormat; }
+		unsigned short getChannels() const { return mChannels; }
+		unsigned int getSampleRate() const { return mSampleRate; }
+		unsigned short getBitsPerSample() const { return mBitsPerSample; }
+		const std::string& getPath() const { return mPath; }
+		uint64_t getLoopStart() const { return mLoopStart; }
+		uint64_t getLoopEnd() const { return mLoopEnd; }
+		// Size of PCM data in the AL buffer.
+		size_t getSize() const { return mBytes; }
+		// How long decoding took, in seconds.
+		double getDecodeTime() const { return mDecodeTime; }
+		// Interleaved 16-bit samples of the clip, for analysis.
+		// Unless the clip was loaded with tKeepPcm, first call decodes the file again,
+		// so call it off the main thread. Returns nullptr if file can't be decoded anymore.
+		std::shared_ptr<const std::vector<int16_t>> getPcm() {
+			std::lock_guard<std::mutex> lock(mPcmMutex);
+			if(mPcm || mPcmFailed) return mPcm;
+			Decoder decoder;
+			if(!decoder.open(mPath)) {
+				mPcmFailed = true;
+				return nullptr;
+			}
+			std::shared_ptr<std::vector<int16_t>> pcm = std::make_shared<std::vector<int16_t>>();
+			decoder.readAll(*pcm);
+			mPcm = pcm;
+			return mPcm;
+		}
+
+	private:
+		Clip() = default;
+		Clip(const Clip&) = delete;
+		Clip& operator=(const Clip&) = delete;
+
+		static std::unordered_map<std::string, std::weak_ptr<Clip>>& _cache() {
+			static std::unordered_map<std::string, std::weak_ptr<Clip>> cache;
+			return cache;
+		}
+
+		/* AL data */
+		ALuint mBuffer = 0;
+		ALenum mFormat = 0;
+
+		/* File info */
+		std::string mPath;
+		unsigned short mChannels = 0;
+		unsigned int mSampleRate = 0;
+		unsigned short mBitsPerSample = 0;
+		uint64_t mLoopStart = 0, mLoopEnd = 0;
+		size_t mBytes = 0;
+		double mDecodeTime = 0;
+
+		/* Samples kept in RAM */
+		std::mutex mPcmMutex;
+		std::shared_ptr<const std::vector<int16_t>> mPcm;
+		bool mPcmFailed = false;
+
+		bool _load(const std::string& tSrc, bool tKeepPcm) {
+			auto start = std::chrono::steady_clock::now();
+			Decoder decoder;
+			if(!decoder.open(tSrc)) return false;
+
+			mChannels = decoder.getChannels();
+			mSampleRate = decoder.getSampleRate();
+			mBitsPerSample = 16;
+			mFormat = decoder.getALFormat();
+
+			mLoopStart = decoder.getLoopStart();
+			mLoopEnd = decoder.getLoopEnd();
+			bool hasLoop = decoder.hasLoopPoints();
+
+			std::vector<int16_t> soundData;
+			decoder.readAll(soundData);
+			decoder.close();
+			auto decoded = std::chrono::steady_clock::now() - start;
+			mDecodeTime = std::chrono::duration<double>(decoded).count();
+			FSOAL_STAT(StatsCounters::clipDecoded(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(decoded).count())));
+
+			oalGetError(); // clear error code 
+			oalBufferData(mBuffer, mFormat, soundData.data(), static_cast<ALsizei>(soundData.size() * sizeof(int16_t)), mSampleRate);
+			size_t bytes = soundData.size() * sizeof(int16_t);
+			if(tKeepPcm) mPcm = std::make_shared<const std::vector<int16_t>>(std::move(soundData));
+			else soundData.clear(); // erase the sound in RAM
+			if(oalGetError() != AL_NO_ERROR) return false;
+			// Loop region from file tags, so AL_LOOPING sources repeat only that part.
+			if(hasLoop && alIsExtensionPresent("AL_SOFT_loop_points")) {
+				ALint points[2] = { static_cast<ALint>(mLoopStart), static_cast<ALint>(mLoopEnd) };
+				oalBufferiv(mBuffer, AL_LOOP_POINTS_SOFT, points);
+				if(oalGetError() != AL_NO_ERROR)
+					LOG_WARN("Couldn't set loop points of \"" + tSrc + "\", it will loop whole.");
+			}
+			mBytes = bytes;
+			FSOAL_STAT(StatsCounters::add(SC_BUFFER_BYTES, static_cast<int64_t>(mBytes)));
+			return true;
+		}
+	};
+
+}
+
+#endif // !FS_OAL_CLIP
@@ -0,0 +1,186 @@
+#ifndef FS_OAL_CLUSTER
+#define FS_OAL_CLUSTER
+
+#include <memory>
+#include <unordered_map>
+#include <cmath>
+#include <algorithm>
+
+#include "defenitions.hpp"
+#include "source.hpp"
+
+namespace FSOAL {
+
+	// Audio LOD for crowds of identical emitters.
+	// Far away sources playing the same clip are merged (per grid cell) into a single voice
+	// placed at their centroid. Members are stopped while clustered and resumed
+	// when the listener comes closer again (unless stop() was called on them meanwhile).
+	class Clusters {
+	public:
+		Clusters(float tDistance = 30.f, float tCellSize = 10.f)
+			: mDistance(tDistance), mCellSize(tCellSize) { }
+		~Clusters() { clear(); }
+
+		void add(Source* tSource) {
+			if(!tSource) return;
+			for(const Member& m : mMembers)
+				if(m.source == tSource) return;
+			mMembers.push_back({ tSource });
+		}
+		void remove(Source* tSource) {
+			for(size_t i = 0; i < mMembers.size(); i++) {
+				if(mMembers[i].source != tSource) continue;
+				// Only the cluster of the removed member splits up, the moved last member keeps its cluster.
+				size_t last = mMembers.size() - 1;
+				for(auto it = mClusters.begin(); it != mClusters.end();) {
+					std::vector<size_t>& members = it->second.members;
+					if(std::find(members.begin(), members.end(), i) != members.end()) {
+						float offset = it->second.voice->getOffset();
+						for(size_t m : members)
+							if(mMembers[m].parked) _unpark(mMembers[m], offset);
+						mVoicesSaved -= members.size() - 1;
+						it = mClusters.erase(it);
+						continue;
+					}
+					std::replace(members.begin(), members.end(), last, i);
+					it++;
+				}
+				mMembers[i] = mMembers.back();
+				mMembers.pop_back();
+				return;
+			}
+		}
+		void clear() {
+			_dissolve();
+			mMembers.clear();
+		}
+
+		void update(glm::vec3 tListenerPos) {
+			if(!oalGlobalInitState) return;
+			// Bucket far emitters by clip and cell.
+			std::unordered_map<Key, std::vector<size_t>, KeyHash> buckets;
+			for(size_t i = 0; i < mMembers.size(); i++) {
+				Member& m = mMembers[i];
+				// Parked members keep reporting playing, unless they were stopped meanwhile.
+				if(!m.source->isPlaying()) continue;
+				if(!m.source->getClip() || !m.source->isLooping()) continue;
+				glm::vec3 pos = m.source->getPostion();
+				// Parked emitters split a bit closer than they merge to avoid flickering on the border.
+				float threshold = m.parked ? mDistance * mHysteresis : mDistance;
+				if(glm::length(pos - tListenerPos) < threshold) continue;
+				Key key{ m.source->getClip().get(),
+					static_cast<int>(std::floor(pos.x / mCellSize)),
+					static_cast<int>(std::floor(pos.y / mCellSize)),
+					static_cast<int>(std::floor(pos.z / mCellSize)) };
+				buckets[key].push_back(i);
+			}
+			std::vector<char> clustered(mMembers.size(), 0);
+			for(auto& [key, members] : buckets)
+				if(members.size() >= mMinMembers)
+					for(size_t i : members) clustered[i] = 1;
+			// Resume members that leave their cluster, keeping loop phase of its voice.
+			for(auto it = mClusters.begin(); it != mClusters.end();) {
+				float offset = it->second.voice->getOffset();
+				for(size_t i : it->second.members)
+					if(!clustered[i] && mMembers[i].parked) _unpark(mMembers[i], offset);
+				auto bucket = buckets.find(it->first);
+				if(bucket == buckets.end() || bucket->second.size() < mMinMembers) it = mClusters.erase(it);
+				else it++;
+			}
+			// Form new clusters and refresh existing ones.
+			mVoicesSaved = 0;
+			for(auto& [key, members] : buckets) {
+				if(members.size() < mMinMembers) continue;
+				auto it = mClusters.find(key);
+				if(it == mClusters.end()) {
+					Source* first = mMembers[members[0]].source;
+					Cluster cluster;
+					cluster.voice = std::make_unique<Source>();
+					if(!cluster.voice->init(first->getClip()->getPath(), 1.f, true)) continue;
+					cluster.voice->setOffset(first->getOffset());
+					cluster.voice->play();
+					it = mClusters.emplace(key, std::move(cluster)).first;
+				}
+				Cluster& cluster = it->second;
+				// Uncorrelated copies of a loop add up in power, not amplitude.
+				glm::vec3 centroid(0);
+				float power = 0;
+				for(size_t i : members) {
+					Member& m = mMembers[i];
+					if(!m.parked) {
+						// Stopped on AL side only, so the source still tells whether it's wanted playing.
+						oalSourceStop(m.source->getHandle());
+						m.parked = true;
+					}
+					centroid += m.source->getPostion();
+					float gain = m.source->isMuted() ? 0.f : m.source->getGain();
+					power += gain * gain;
+				}
+				cluster.members = members;
+				cluster.voice->setPostion(centroid / static_cast<float>(members.size()));
+				cluster.voice->setGain(std::sqrt(power));
+				mVoicesSaved += members.size() - 1;
+			}
+		}
+
+		Clusters* setDistance(float tDistance) { mDistance = tDistance; return this; }
+		Clusters* setCellSize(float tSize) { mCellSize = tSize; return this; }
+		Clusters* setMinMembers(size_t tCount) { mMinMembers = tCount < 2 ? 2 : tCount; return this; }
+		// Fraction of distance at which clustered emitters split up again.
+		Clusters* setHysteresis(float tFraction) { mHysteresis = tFraction; return this; }
+
+		size_t getClusterCount() const { return mClusters.size(); }
+		size_t getVoicesSaved() const { return mVoicesSaved; }
+	private:
+		struct Member {
+			Source* source = nullptr;
+			bool parked = false;
+		};
+		struct Key {
+			const Clip* clip;
+			int x, y, z;
+			bool operator==(const Key& tOther) const {
+				return clip == tOther.clip && x == tOther.x && y == tOther.y && z == tOther.z;
+			}
+		};
+		struct KeyHash {
+			size_t operator()(const Key& tKey) const {
+				size_t h = std::hash<const void*>()(tKey.clip);
+				h ^= (static_cast<size_t>(tKey.x) * 73856093u) ^ (static_cast<size_t>(tKey.y) * 19349663u) ^ (static_cast<size_t>(tKey.z) * 83492791u);
+				return h;
+			}
+		};
+		struct Cluster {
+			std::unique_ptr<Source> voice;
+			std::vector<size_t> members;
+		};
+
+		// Resumes member, if it wasn't stopped while parked.
+		void _unpark(Member& tMember, float tOffset) {
+			tMember.parked = false;
+			if(!tMember.source->isPlaying()) return;
+			tMember.source->play();
+			tMember.source->setOffset(tOffset);
+		}
+		void _dissolve() {
+			for(auto& [key, cluster] : mClusters) {
+				float offset = cluster.voice->getOffset();
+				for(size_t i : cluster.members)
+					if(mMembers[i].parked) _unpark(mMembers[i], offset);
+			}
+			mClusters.clear();
+			mVoicesSaved = 0;
+		}
+
+		float mDistance, mCellSize;
+		float mHysteresis = 0.9f;
+		size_t mMinMembers = 2;
+		size_t mVoicesSaved = 0;
+
+		std::vector<Member> mMembers;
+		std::unordered_map<Key, Cluster, KeyHash> mClusters;
+	};
+
+}
+
+#endif // !FS_OAL_CLUSTER
@@ -0,0 +1,60 @@
+#ifndef FS_OAL_CODECS
+#define FS_OAL_CODECS
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Interface to the compiled decoder library (fsoal_codecs, see src/).
+// Decoder implementations live in the library only, so including this header costs nothing.
+
+namespace FSOAL {
+
+	enum AudioFormat {
+		AF_UNKNOWN = 0,
+		AF_WAV,
+		AF_MP3,
+		AF_FLAC,
+		AF_VORBIS,
+		AF_OPUS
+	};
+
+	// Instruction sets decoder vector paths can be built for.
+	enum DecoderSimd {
+		DS_NONE = 0,
+		DS_SSE2,
+		DS_SSE41,
+		DS_AVX2
+	};
+
+	// Set of functions decoding one file format.
+	// Every backend outputs interleaved frames, as signed 16-bit or as float.
+	struct DecoderBackend {
+		AudioFormat format;
+		void* (*open)(const char* tSrc, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames);
+		// Data must stay alive until the handle is closed.
+		void* (*openMemory)(const void* tData, size_t tSize, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames);
+		uint64_t (*read)(void* tHandle, uint64_t tFrames, int16_t* tOut);
+		uint64_t (*readF32)(void* tHandle, uint64_t tFrames, float* tOut);
+		bool (*seek)(void* tHandle, uint64_t tFrame);
+		void (*close)(void* tHandle);
+		// Optional. Reads loop region stored in file metadata.
+		bool (*loop)(void* tHandle, uint64_t tFrames, uint64_t* tStart, uint64_t* tEnd);
+	};
+
+	// Backends in the order formats are tried when a file can't be recognized by its header.
+	// MP3 and FLAC entries point to the best variant for current CPU.
+	const std::vector<const DecoderBackend*>& _decoderBackends();
+
+	// Best instruction set supported by both the CPU and the build.
+	DecoderSimd getDecoderSimdSupport();
+	// Instruction set decoders opened from now on will use.
+	DecoderSimd getDecoderSimd();
+	// Forces decoders down to given instruction set (clamped to what is supported). Returns level in use.
+	// Meant for benchmarks, don't call while other threads open decoders.
+	DecoderSimd setDecoderSimd(DecoderSimd tSimd);
+	const char* getDecoderSimdName(DecoderSimd tSimd);
+
+}
+
+#endif // !FS_OAL_CODECS
@@ -0,0 +1,142 @@
+#ifndef FS_OAL_DECODER
+#define FS_OAL_DECODER
+
+#include <cstdio>
+#include <cstring>
+
+#include "defenitions.hpp"
+#include "codecs.hpp"
+
+namespace FSOAL {
+
+	// Incremental decoder over all supported formats.
+	// Format is guessed from the file header first. If that fails, every backend is tried
+	// in the order Source always used: WAV, MP3, FLAC (then Vorbis and Opus).
+	class Decoder {
+	public:
+		Decoder() = default;
+		~Decoder() { close(); }
+		Decoder(const Decoder&) = delete;
+		Decoder& operator=(const Decoder&) = delete;
+
+		bool open(const std::string& tSrc) {
+			close();
+			return _open(probe(tSrc), [&tSrc, this](const DecoderBackend* tBackend) {
+				return tBackend->open(tSrc.c_str(), &mChannels, &mSampleRate, &mFrameCount);
+			});
+		}
+		// Decodes a file already loaded into memory. Data must outlive the decoder (or next open/close).
+		bool openMemory(const void* tData, size_t tSize) {
+			close();
+			return _open(probe(tData, tSize), [tData, tSize, this](const DecoderBackend* tBackend) {
+				return tBackend->openMemory(tData, tSize, &mChannels, &mSampleRate, &mFrameCount);
+			});
+		}
+		// Guesses file format by its first bytes.
+		static AudioFormat probe(const std::string& tSrc) {
+			unsigned char head[36]{};
+			FILE* file = fopen(tSrc.c_str(), "rb");
+			if(!file) return AF_UNKNOWN;
+			size_t size = fread(head, 1, sizeof(head), file);
+			fclose(file);
+			return probe(head, size);
+		}
+		static AudioFormat probe(const void* tData, size_t tSize) {
+			const unsigned char* head = static_cast<const unsigned char*>(tData);
+			if(!head || tSize < 4) return AF_UNKNOWN;
+			if(!memcmp(head, "RIFF", 4) || !memcmp(head, "RF64", 4) || !memcmp(head, "riff", 4)) return AF_WAV;
+			if(!memcmp(head, "fLaC", 4)) return AF_FLAC;
+			if(!memcmp(head, "OggS", 4) && tSize >= 36) {
+				if(!memcmp(head + 28, "OpusHead", 8)) return AF_OPUS;
+				if(!memcmp(head + 28, "\x01vorbis", 7)) return AF_VORBIS;
+				if(!memcmp(head + 28, "\x7F" "FLAC", 5)) return AF_FLAC;
+				return AF_UNKNOWN;
+			}
+			if(!memcmp(head, "ID3", 3) || (head[0] == 0xFF && (head[1] & 0xE0) == 0xE0)) return AF_MP3;
+			return AF_UNKNOWN;
+		}
+		void close() {
+			if(mHandle) mBackend->close(mHandle);
+			mHandle = nullptr;
+			mBackend = nullptr;
+		}
+
+		// Reads up to given amount of frames. Returns amount of frames actually read.
+		uint64_t read(int16_t* tOut, uint64_t tFrames) {
+			if(!mHandle) return 0;
+			uint64_t read = mBackend->read(mHandle, tFrames, tOut);
+			mCursor += read;
+			return read;
+		}
+		// Same as above, in [-1;1] floats.
+		uint64_t read(float* tOut, uint64_t tFrames) {
+			if(!mHandle) return 0;
+			uint64_t read = mBackend->readF32(mHandle, tFrames, tOut);
+			mCursor += read;
+			return read;
+		}
+		// Decodes everything left into given vector.
+		template<typename T>
+		uint64_t readAll(std::vector<T>& tOut) {
+			if(!mHandle) return 0;
+			tOut.resize(static_cast<size_t>((mFrameCount - mCursor) * mChannels));
+			uint64_t read = this->read(tOut.data(), mFrameCount - mCursor);
+			tOut.resize(static_cast<size_t>(read * mChannels));
+			return read;
+		}
+		bool seek(uint64_t tFrame) {
+			if(!mHandle || !mBackend->seek(mHandle, tFrame)) return false;
+			mCursor = tFrame;
+			return true;
+		}
+
+		bool isOpen() const { return mHandle != nullptr; }
+		bool isAtEnd() const { return mCursor >= mFrameCount; }
+		AudioFormat getFormat() const { return mBackend ? mBackend->format : AF_UNKNOWN; }
+		unsigned short getChannels() const { return mChannels; }
+		unsigned int getSampleRate() const { return mSampleRate; }
+		uint64_t getFrameCount() const { return mFrameCount; }
+		uint64_t getCursor() const { return mCursor; }
+		// Loop region from file metadata (whole file if there is none).
+		uint64_t getLoopStart() const { return mLoopStart; }
+		uint64_t getLoopEnd() const { return mLoopEnd; }
+		bool hasLoopPoints() const { return mLoopStart != 0 || mLoopEnd != mFrameCount; }
+		// Decoder output is always 16-bit, so only channel count matters.
+		ALenum getALFormat() const {
+			if(mChannels == 1) return AL_FORMAT_MONO16;
+			if(mChannels == 2) return AL_FORMAT_STEREO16;
+			LOG_WARN("Unsupported audio: " + std::to_string(static_cast<int>(mChannels)) +
+				" channels | " + std::to_string(static_cast<int>(mSampleRate)) + " sample rate");
+			return AL_FORMAT_STEREO16;
+		}
+	private:
+		template<typename F>
+		bool _open(AudioFormat tGuess, F tOpen) {
+			for(int pass = 0; pass < 2; pass++)
+				for(const DecoderBackend* backend : _decoderBackends()) {
+					// First pass tries only the guessed format, second one everything else.
+					if((pass == 0) != (backend->format == tGuess)) continue;
+					mHandle = tOpen(backend);
+					if(!mHandle) continue;
+					mBackend = backend;
+					mCursor = 0;
+					mLoopStart = 0;
+					mLoopEnd = mFrameCount;
+					if(mBackend->loop) mBackend->loop(mHandle, mFrameCount, &mLoopStart, &mLoopEnd);
+					return true;
+				}
+			return false;
+		}
+
+		const DecoderBackend* mBackend = nullptr;
+		void* mHandle = nullptr;
+		unsigned short mChannels = 0;
+		unsigned int mSampleRate = 0;
+		uint64_t mFrameCount = 0;
+		uint64_t mCursor = 0;
+		uint64_t mLoopStart = 0, mLoopEnd = 0;
+	};
+
+}
+
+#endif // !FS_OAL_DECODER
@@ -8,6 +8,8 @@
 #include <al.h>
 #include <alc.h>
 #include <alext.h>
+#include <efx.h>
+#include "stats.hpp"
 
 namespace FSOAL {
 
@@ -15,6 +17,71 @@ namespace FSOAL {
     static ALCcontext* ALCONTEXT;
     static bool oalGlobalInitState;
 
+    /* EFX entry points (loaded on initialize if ALC_EXT_EFX is present) */
+    static bool oalEfxSupported;
+    static LPALGENFILTERS efxGenFilters;
+    static LPALDELETEFILTERS efxDeleteFilters;
+    static LPALFILTERI efxFilteri;
+    static LPALFILTERF efxFilterf;
+
+    static void _loadEfx() {
+        oalEfxSupported = false;
+        if(!alcIsExtensionPresent(ALCDEVICE, "ALC_EXT_EFX")) return;
+        efxGenFilters = reinterpret_cast<LPALGENFILTERS>(alGetProcAddress("alGenFilters"));
+        efxDeleteFilters = reinterpret_cast<LPALDELETEFILTERS>(alGetProcAddress("alDeleteFilters"));
+        efxFilteri = reinterpret_cast<LPALFILTERI>(alGetProcAddress("alFilteri"));
+        efxFilterf = reinterpret_cast<LPALFILTERF>(alGetProcAddress("alFilterf"));
+        oalEfxSupported = efxGenFilters && efxDeleteFilters && efxFilteri && efxFilterf;
+    }
+
+    /* AL_SOFT_callback_buffer entry point */
+    static bool oalCallbackBufferSupported;
+    static LPALBUFFERCALLBACKSOFT softBufferCallback;
+
+    static void _loadCallbackBuffer() {
+        oalCallbackBufferSupported = false;
+        if(!alIsExtensionPresent("AL_SOFT_callback_buffer") || !alIsExtensionPresent("AL_EXT_float32")) return;
+        softBufferCallback = reinterpret_cast<LPALBUFFERCALLBACKSOFT>(alGetProcAddress("alBufferCallbackSOFT"));
+        oalCallbackBufferSupported = softBufferCallback != nullptr;
+    }
+
+    /* Counted AL calls. Package code calls AL through these (oalSourcei for alSourcei and so on),
+       so Stats can count them without redefining the AL API. */
+#define FSOAL_COUNTED_CALL(tName, tFunction) \
+    template<typename... tArgs> \
+    static auto tName(tArgs... tArguments) -> decltype(tFunction(tArguments...)) { \
+        _countAlCall(); \
+        return tFunction(tArguments...); \
+    }
+    FSOAL_COUNTED_CALL(oalGetError, alGetError)
+    FSOAL_COUNTED_CALL(oalGenBuffers, alGenBuffers)
+    FSOAL_COUNTED_CALL(oalDeleteBuffers, alDeleteBuffers)
+    FSOAL_COUNTED_CALL(oalBufferData, alBufferData)
+    FSOAL_COUNTED_CALL(oalBufferiv, alBufferiv)
+    FSOAL_COUNTED_CALL(oalGetBufferi, alGetBufferi)
+    FSOAL_COUNTED_CALL(oalGenSources, alGenSources)
+    FSOAL_COUNTED_CALL(oalDeleteSources, alDeleteSources)
+    FSOAL_COUNTED_CALL(oalSourcei, alSourcei)
+    FSOAL_COUNTED_CALL(oalSource3i, alSource3i)
+    FSOAL_COUNTED_CALL(oalSourcef, alSourcef)
+    FSOAL_COUNTED_CALL(oalSource3f, alSource3f)
+    FSOAL_COUNTED_CALL(oalGetSourcei, alGetSourcei)
+    FSOAL_COUNTED_CALL(oalGetSourcef, alGetSourcef)
+    FSOAL_COUNTED_CALL(oalSourcePlay, alSourcePlay)
+    FSOAL_COUNTED_CALL(oalSourceStop, alSourceStop)
+    FSOAL_COUNTED_CALL(oalSourcePause, alSourcePause)
+    FSOAL_COUNTED_CALL(oalSourceQueueBuffers, alSourceQueueBuffers)
+    FSOAL_COUNTED_CALL(oalSourceUnqueueBuffers, alSourceUnqueueBuffers)
+    FSOAL_COUNTED_CALL(oalListener3f, alListener3f)
+    FSOAL_COUNTED_CALL(oalListenerfv, alListenerfv)
+    FSOAL_COUNTED_CALL(oalDistanceModel, alDistanceModel)
+    FSOAL_COUNTED_CALL(oalGenFilters, efxGenFilters)
+    FSOAL_COUNTED_CALL(oalDeleteFilters, efxDeleteFilters)
+    FSOAL_COUNTED_CALL(oalFilteri, efxFilteri)
+    FSOAL_COUNTED_CALL(oalFilterf, efxFilterf)
+    FSOAL_COUNTED_CALL(oalBufferCallback, softBufferCallback)
+#undef FSOAL_COUNTED_CALL
+
 	static bool initialize() {
         char const* device_name = nullptr;
         device_name = alcGetString(NULL, ALC_DEFAULT_DEVICE_SPECIFIER);
@@ -27,6 +94,8 @@ namespace FSOAL {
         ALCONTEXT = alcCreateContext(ALCDEVICE, (ALCint*)nullptr);
         ALCboolean contextMadeCurrent = false;
         alcMakeContextCurrent(ALCONTEXT);
+        _loadEfx();
+        _loadCallbackBuffer();
         oalGlobalInitState = true;
         return true;
 	}
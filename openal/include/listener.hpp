@@ -22,7 +22,7 @@ namespace FSOAL {
 	public:
 		static void setPosition(glm::vec3 tPos) {
 			if(!oalGlobalInitState) return;
-			alListener3f(AL_POSITION, tPos.x, tPos.y, tPos.z);
+			oalListener3f(AL_POSITION, tPos.x, tPos.y, tPos.z);
 		}
 		static void setRotation(glm::vec3 tForward, glm::vec3 tUp) {
 			if(!oalGlobalInitState) return;
@@ -31,11 +31,11 @@ namespace FSOAL {
 				tUp.x, tUp.y, tUp.z
 			};
 
-			alListenerfv(AL_ORIENTATION, orientation);
+			oalListenerfv(AL_ORIENTATION, orientation);
 		}
 		static void setDistanceModel(DistanceModel tMode) {
 			if(!oalGlobalInitState) return;
-			alDistanceModel(tMode);
+			oalDistanceModel(tMode);
 		}
 	};
 
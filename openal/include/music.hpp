@@ -0,0 +1,167 @@
+#ifndef FS_OAL_MUSIC
+#define FS_OAL_MUSIC
+
+#include <cmath>
+
+#include "defenitions.hpp"
+#include "stream.hpp"
+
+namespace FSOAL {
+
+	enum RepeatMode {
+		RM_NONE = 0,
+		RM_ALL,
+		RM_ONE
+	};
+
+	// Playlist player on top of streams.
+	// Next track is opened and pre-rolled on a worker thread some seconds before the current one ends.
+	// With no crossfade it gets queued right after the current track on the same source (gapless),
+	// otherwise it starts on a second stream and both are faded with an equal-power curve.
+	class MusicPlayer {
+	public:
+		MusicPlayer(float tGain = 1) : mGain(tGain) { }
+		~MusicPlayer() { remove(); }
+
+		bool initialize() {
+			if(!oalGlobalInitState) return false;
+			return mStreams[0].initialize() && mStreams[1].initialize();
+		}
+		void remove() {
+			stop();
+			mStreams[0].remove();
+			mStreams[1].remove();
+		}
+
+		MusicPlayer* add(const std::string& tSrc) {
+			mPlaylist.push_back(tSrc);
+			return this;
+		}
+		void clear() {
+			stop();
+			mPlaylist.clear();
+		}
+
+		void play(size_t tIndex = 0) {
+			if(!oalGlobalInitState || tIndex >= mPlaylist.size()) return;
+			stop();
+			mCurrent = tIndex;
+			Stream& stream = mStreams[mActive];
+			stream.enqueue(Track::open(mPlaylist[tIndex], mRepeat == RM_ONE));
+			stream.setGain(mGain);
+			stream.play();
+			mPlaying = true;
+		}
+		void stop() {
+			mStreams[0].clear();
+			mStreams[1].clear();
+			mNext.reset();
+			mNextQueued = mFading = mPlaying = false;
+		}
+		// Skips to the next track, using the pre-rolled one if it's ready.
+		void next() {
+			if(!mPlaying) return;
+			size_t index;
+			if(!_nextIndex(index)) { stop(); return; }
+			if(mNext && mNext->isReady() && !mNextQueued && !mFading) {
+				_startFade(index);
+				return;
+			}
+			play(index);
+		}
+
+		void update(float tDelta) {
+			if(!oalGlobalInitState || !mPlaying) return;
+			Stream& current = mStreams[mActive];
+			Stream& other = mStreams[1 - mActive];
+			current.update();
+			other.update();
+			// Crossfade in progress.
+			if(mFading) {
+				mFade = mCrossfade > 0 ? mFade + tDelta / mCrossfade : 1.f;
+				if(mFade < 1.f) {
+					const float halfPi = 1.5707963f;
+					current.setGain(mGain * std::cos(mFade * halfPi));
+					other.setGain(mGain * std::sin(mFade * halfPi));
+					return;
+				}
+				current.clear();
+				other.setGain(mGain);
+				mActive = 1 - mActive;
+				mFading = false;
+				return;
+			}
+			// Gapless switch already happened inside the stream.
+			if(mNextQueued && current.getCurrent() == mNext) {
+				mCurrent = mNextIndex;
+				mNext.reset();
+				mNextQueued = false;
+			}
+			// Pre-roll next track.
+			float remaining = current.getRemaining();
+			if(!mNext && remaining <= mPreload + mCrossfade && _nextIndex(mNextIndex))
+				mNext = Track::open(mPlaylist[mNextIndex]);
+			if(mNext && !mNextQueued && mNext->isReady()) {
+				if(mCrossfade <= 0) {
+					current.enqueue(mNext);
+					mNextQueued = true;
+				}
+				else if(remaining <= mCrossfade) _startFade(mNextIndex);
+			}
+			if(!current.isPlaying() && !mNext) mPlaying = false;
+		}
+
+		// Crossfade time in seconds, 0 plays tracks back-to-back.
+		MusicPlayer* setCrossfade(float tSeconds) { mCrossfade = tSeconds < 0 ? 0 : tSeconds; return this; }
+		// How many seconds before the end of current track the next one is opened.
+		MusicPlayer* setPreload(float tSeconds) { mPreload = tSeconds; return this; }
+		MusicPlayer* setRepeat(RepeatMode tMode) { mRepeat = tMode; return this; }
+		MusicPlayer* setGain(float tGain) {
+			mGain = tGain;
+			if(!mFading) mStreams[mActive].setGain(mGain);
+			return this;
+		}
+
+		size_t getCurrentIndex() const { return mCurrent; }
+		const std::string& getCurrentPath() const { return mPlaylist[mCurrent]; }
+		size_t getTrackCount() const { return mPlaylist.size(); }
+		float getPosition() const { return mStreams[mActive].getPosition(); }
+		float getGain() const { return mGain; }
+		bool isPlaying() const { return mPlaying; }
+		bool isFading() const { return mFading; }
+
+	private:
+		bool _nextIndex(size_t& tIndex) const {
+			if(mPlaylist.empty() || mRepeat == RM_ONE) return false;
+			if(mCurrent + 1 < mPlaylist.size()) tIndex = mCurrent + 1;
+			else if(mRepeat == RM_ALL) tIndex = 0;
+			else return false;
+			return true;
+		}
+		void _startFade(size_t tIndex) {
+			Stream& other = mStreams[1 - mActive];
+			other.clear();
+			other.enqueue(mNext);
+			other.setGain(0);
+			other.play();
+			mCurrent = tIndex;
+			mNext.reset();
+			mFade = 0;
+			mFading = true;
+		}
+
+		std::vector<std::string> mPlaylist;
+		Stream mStreams[2];
+		size_t mActive = 0;
+		size_t mCurrent = 0, mNextIndex = 0;
+		std::shared_ptr<Track> mNext;
+
+		float mGain;
+		float mCrossfade = 0, mPreload = 5.f, mFade = 0;
+		RepeatMode mRepeat = RM_NONE;
+		bool mPlaying = false, mNextQueued = false, mFading = false;
+	};
+
+}
+
+#endif // !FS_OAL_MUSIC
@@ -0,0 +1,181 @@
+#ifndef FS_OAL_OCCLUSION
+#define FS_OAL_OCCLUSION
+
+#include <algorithm>
+#include <cmath>
+#include <btBulletCollisionCommon.h>
+
+#include "defenitions.hpp"
+#include "source.hpp"
+#include "worker.hpp"
+
+// [!NOTE]
+// Requires fs.phys.3d package (BulletCollision), which puts Bullet headers on the include path.
+
+namespace FSOAL {
+
+	// Muffles sources hidden behind level geometry with an EFX low-pass filter.
+	// Only a fixed amount of rays is cast per frame, so the cost doesn't grow with emitter count.
+	// Emitters are picked in round-robin order weighted by how audible they are.
+	// [!WARNING]
+	// Rays are cast on a worker thread while the frame goes on.
+	// Call sync() before changing the collision world (stepSimulation, adding/removing bodies).
+	class Occlusion {
+	public:
+		Occlusion(btCollisionWorld* tWorld = nullptr, unsigned int tRaysPerFrame = 16)
+			: mWorld(tWorld), mRaysPerFrame(tRaysPerFrame) { }
+		~Occlusion() { clear(); }
+
+		bool add(Source* tSource) {
+			if(!oalGlobalInitState || !tSource) return false;
+			if(!oalEfxSupported) {
+				LOG_WARN("Couldn't add occlusion to source: EFX isn't supported by the device.");
+				return false;
+			}
+			sync();
+			for(const Emitter& e : mEmitters)
+				if(e.source == tSource) return true;
+			Emitter e;
+			e.source = tSource;
+			oalGetError(); // clear error code
+			oalGenFilters(1, &e.filter);
+			oalFilteri(e.filter, AL_FILTER_TYPE, AL_FILTER_LOWPASS);
+			if(oalGetError() != AL_NO_ERROR) {
+				oalDeleteFilters(1, &e.filter);
+				return false;
+			}
+			_apply(e);
+			mEmitters.push_back(e);
+			return true;
+		}
+		void remove(Source* tSource) {
+			sync();
+			for(size_t i = 0; i < mEmitters.size(); i++) {
+				if(mEmitters[i].source != tSource) continue;
+				_release(mEmitters[i]);
+				// Finished rays of the removed emitter are dropped, the ones of the moved last emitter follow it.
+				size_t last = mEmitters.size() - 1;
+				mRays.erase(std::remove_if(mRays.begin(), mRays.end(), [i](const Ray& r) { return r.emitter == i; }), mRays.end());
+				for(Ray& r : mRays)
+					if(r.emitter == last) r.emitter = i;
+				mEmitters[i] = mEmitters.back();
+				mEmitters.pop_back();
+				return;
+			}
+		}
+		void clear() {
+			sync();
+			for(Emitter& e : mEmitters) _release(e);
+			mEmitters.clear();
+			mRays.clear();
+		}
+
+		// Collects results of the previous ray batch, smooths filters and sends the next batch.
+		void update(glm::vec3 tListenerPos, float tDelta) {
+			if(!oalGlobalInitState) return;
+			sync();
+			// Apply finished rays.
+			for(const Ray& r : mRays) {
+				Emitter& e = mEmitters[r.emitter];
+				e.targetGain = std::pow(mOccludedGain, static_cast<float>(r.hits));
+				e.targetGainHF = std::pow(mOccludedGainHF, static_cast<float>(r.hits));
+			}
+			mRays.clear();
+			// Smooth filters and age priorities.
+			float k = mSmoothing > 0 ? 1.f - std::exp(-tDelta / mSmoothing) : 1.f;
+			mOrder.clear();
+			for(size_t i = 0; i < mEmitters.size(); i++) {
+				Emitter& e = mEmitters[i];
+				e.gain += (e.targetGain - e.gain) * k;
+				e.gainHF += (e.targetGainHF - e.gainHF) * k;
+				if(std::abs(e.gain - e.appliedGain) > 0.001f || std::abs(e.gainHF - e.appliedGainHF) > 0.001f)
+					_apply(e);
+				if(!e.source->isPlaying() || e.source->isMuted()) continue;
+				float dist = glm::length(e.source->getPostion() - tListenerPos);
+				e.priority += e.source->getGain() / std::max(dist, 1.f) * tDelta;
+				mOrder.push_back(i);
+			}
+			if(!mWorld || mOrder.empty() || mRaysPerFrame == 0) return;
+			// Pick most starved emitters.
+			size_t count = std::min<size_t>(mRaysPerFrame, mOrder.size());
+			auto byPriority = [this](size_t a, size_t b) { return mEmitters[a].priority > mEmitters[b].priority; };
+			if(count < mOrder.size())
+				std::nth_element(mOrder.begin(), mOrder.begin() + count, mOrder.end(), byPriority);
+			for(size_t i = 0; i < count; i++) {
+				Emitter& e = mEmitters[mOrder[i]];
+				e.priority = 0;
+				mRays.push_back({ mOrder[i], tListenerPos, e.source->getPostion(), 0 });
+			}
+			// Cast rays on a worker. Only one: Bullet built without BT_THREADSAFE
+			// shares one ray test stack in the broadphase, so parallel rayTest() calls would race.
+			mGroup.run([this]() { _cast(0, mRays.size()); });
+		}
+		// Waits for in-flight rays.
+		void sync() { mGroup.wait(); }
+
+		Occlusion* setWorld(btCollisionWorld* tWorld) { sync(); mWorld = tWorld; return this; }
+		Occlusion* setRaysPerFrame(unsigned int tRays) { mRaysPerFrame = tRays; return this; }
+		// Time (in seconds) filters need to cover ~63% of the way to a new value.
+		Occlusion* setSmoothing(float tSeconds) { mSmoothing = tSeconds; return this; }
+		// Gains left after sound passes a single occluder.
+		Occlusion* setOccluderGain(float tGain, float tGainHF) { mOccludedGain = tGain; mOccludedGainHF = tGainHF; return this; }
+		Occlusion* setCollisionFilter(int tGroup, int tMask) { mFilterGroup = tGroup; mFilterMask = tMask; return this; }
+
+		size_t getEmitterCount() const { return mEmitters.size(); }
+		unsigned int getRaysPerFrame() const { return mRaysPerFrame; }
+	private:
+		struct Emitter {
+			Source* source = nullptr;
+			ALuint filter = 0;
+			float priority = 0;
+			float gain = 1, gainHF = 1;
+			float targetGain = 1, targetGainHF = 1;
+			float appliedGain = -1, appliedGainHF = -1;
+		};
+		struct Ray {
+			size_t emitter;
+			glm::vec3 from, to;
+			unsigned int hits;
+		};
+
+		void _cast(size_t tFirst, size_t tLast) {
+			for(size_t i = tFirst; i < tLast; i++) {
+				Ray& r = mRays[i];
+				btVector3 from(r.from.x, r.from.y, r.from.z), to(r.to.x, r.to.y, r.to.z);
+				btCollisionWorld::AllHitsRayResultCallback result(from, to);
+				result.m_collisionFilterGroup = mFilterGroup;
+				result.m_collisionFilterMask = mFilterMask;
+				mWorld->rayTest(from, to, result);
+				r.hits = result.hasHit() ? static_cast<unsigned int>(result.m_collisionObjects.size()) : 0;
+			}
+		}
+		void _apply(Emitter& tEmitter) {
+			oalFilterf(tEmitter.filter, AL_LOWPASS_GAIN, tEmitter.gain);
+			oalFilterf(tEmitter.filter, AL_LOWPASS_GAINHF, tEmitter.gainHF);
+			// AL copies filter state on attach, so it has to be re-attached after every change.
+			oalSourcei(tEmitter.source->getHandle(), AL_DIRECT_FILTER, static_cast<ALint>(tEmitter.filter));
+			tEmitter.appliedGain = tEmitter.gain;
+			tEmitter.appliedGainHF = tEmitter.gainHF;
+		}
+		void _release(Emitter& tEmitter) {
+			if(!oalGlobalInitState) return;
+			oalSourcei(tEmitter.source->getHandle(), AL_DIRECT_FILTER, AL_FILTER_NULL);
+			oalDeleteFilters(1, &tEmitter.filter);
+		}
+
+		btCollisionWorld* mWorld;
+		unsigned int mRaysPerFrame;
+		float mSmoothing = 0.1f;
+		float mOccludedGain = 0.8f, mOccludedGainHF = 0.25f;
+		int mFilterGroup = btBroadphaseProxy::DefaultFilter;
+		int mFilterMask = btBroadphaseProxy::StaticFilter;
+
+		std::vector<Emitter> mEmitters;
+		std::vector<size_t> mOrder;
+		std::vector<Ray> mRays;
+		WorkGroup mGroup;
+	};
+
+}
+
+#endif // !FS_OAL_OCCLUSION
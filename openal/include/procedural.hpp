@@ -0,0 +1,179 @@
+#ifndef FS_OAL_PROCEDURAL
+#define FS_OAL_PROCEDURAL
+
+#include <atomic>
+
+#include "defenitions.hpp"
+#include "synth.hpp"
+
+namespace FSOAL {
+
+	enum ProceduralParam {
+		PP_FREQUENCY = 0,
+		PP_GAIN,
+		PP_USER0,
+		PP_USER1,
+		PP_USER2,
+		PP_USER3,
+		PP_USER4,
+		PP_USER5,
+
+		PP_COUNT
+	};
+
+	// Values shared between game thread and AL mixer thread.
+	// Every slot is a lock-free atomic, so writers never block the mixer.
+	struct ProceduralParams {
+	public:
+		ProceduralParams() {
+			for(auto& v : mValues) v.store(0, std::memory_order_relaxed);
+			set(PP_FREQUENCY, 440.f);
+			set(PP_GAIN, 1.f);
+		}
+
+		float get(ProceduralParam tParam) const { return mValues[tParam].load(std::memory_order_relaxed); }
+		void set(ProceduralParam tParam, float tValue) { mValues[tParam].store(tValue, std::memory_order_relaxed); }
+
+		// Gate events (note on/off) are counted, so renderer can tell it missed none between two blocks.
+		void noteOn() { mNoteOns.fetch_add(1, std::memory_order_release); }
+		void noteOff() { mNoteOffs.fetch_add(1, std::memory_order_release); }
+		uint32_t getNoteOns() const { return mNoteOns.load(std::memory_order_acquire); }
+		uint32_t getNoteOffs() const { return mNoteOffs.load(std::memory_order_acquire); }
+	private:
+		std::atomic<float> mValues[PP_COUNT];
+		std::atomic<uint32_t> mNoteOns{0}, mNoteOffs{0};
+	};
+
+	// Fills tOut with given amount of mono float frames. Called on the AL mixer thread:
+	// don't allocate, lock or touch AL in it.
+	typedef void(*ProceduralCallback)(float* tOut, unsigned int tFrames, unsigned int tSampleRate,
+		const ProceduralParams& tParams, void* tUserData);
+
+	// Source rendered on demand by the mixer through AL_SOFT_callback_buffer.
+	// Nothing is rendered ahead and no buffers are uploaded while it plays.
+	struct ProceduralSource {
+	public:
+		ProceduralSource(float tGain = 1, glm::vec3 tPos = glm::vec3(0))
+			: mGain(tGain), mPosition(tPos) { }
+		~ProceduralSource() { remove(); }
+		ProceduralSource(const ProceduralSource&) = delete;
+		ProceduralSource& operator=(const ProceduralSource&) = delete;
+
+		bool initialize(ProceduralCallback tCallback, void* tUserData = nullptr, unsigned int tSampleRate = 48000) {
+			if(!oalGlobalInitState || !tCallback) return false;
+			if(!oalCallbackBufferSupported) {
+				LOG_WARN("Couldn't create procedural source: AL_SOFT_callback_buffer isn't supported.");
+				return false;
+			}
+			if(mInited) remove();
+			mCallback = tCallback;
+			mUserData = tUserData;
+			mSampleRate = tSampleRate;
+			oalGetError(); // clear error code
+			oalGenBuffers(1, &mBuffer);
+			oalGenSources(1, &mSource);
+			oalBufferCallback(mBuffer, AL_FORMAT_MONO_FLOAT32, static_cast<ALsizei>(mSampleRate), _render, this);
+			oalSourcei(mSource, AL_BUFFER, static_cast<ALint>(mBuffer));
+			if(oalGetError() != AL_NO_ERROR) {
+				oalDeleteSources(1, &mSource);
+				oalDeleteBuffers(1, &mBuffer);
+				return false;
+			}
+			oalSourcef(mSource, AL_GAIN, mGain);
+			oalSource3f(mSource, AL_POSITION, mPosition.x, mPosition.y, mPosition.z);
+			FSOAL_STAT(StatsCounters::sourceCreated(mSource));
+			mInited = true;
+			return true;
+		}
+		void remove() {
+			if(!oalGlobalInitState || !mInited) return;
+			stop();
+			FSOAL_STAT(StatsCounters::sourceDeleted(mSource));
+			oalDeleteSources(1, &mSource);
+			oalDeleteBuffers(1, &mBuffer);
+			mInited = false;
+		}
+
+		void play() {
+			if(!oalGlobalInitState || !mInited) return;
+			mPlaying = true;
+			oalSourcePlay(mSource);
+		}
+		void stop() {
+			if(!oalGlobalInitState || !mInited) return;
+			mPlaying = false;
+			oalSourceStop(mSource);
+		}
+
+		ProceduralParams& getParams() { return mParams; }
+		unsigned int getSampleRate() const { return mSampleRate; }
+		glm::vec3 getPostion() const { return mPosition; }
+		float getGain() const { return mGain; }
+		bool isPlaying() const { return mPlaying; }
+		bool isInitialized() const { return mInited; }
+		ALuint getHandle() const { return mSource; }
+
+		ProceduralSource* setPostion(glm::vec3 tPos) {
+			if(!oalGlobalInitState) return this;
+			mPosition = tPos;
+			oalSource3f(mSource, AL_POSITION, mPosition.x, mPosition.y, mPosition.z);
+			return this;
+		}
+		ProceduralSource* setGain(float tGain) {
+			if(!oalGlobalInitState) return this;
+			mGain = tGain;
+			oalSourcef(mSource, AL_GAIN, mGain);
+			return this;
+		}
+
+	private:
+		static ALsizei AL_APIENTRY _render(ALvoid* tUser, ALvoid* tData, ALsizei tBytes) noexcept {
+			ProceduralSource* self = static_cast<ProceduralSource*>(tUser);
+			unsigned int frames = static_cast<unsigned int>(tBytes) / sizeof(float);
+			self->mCallback(static_cast<float*>(tData), frames, self->mSampleRate, self->mParams, self->mUserData);
+			return tBytes;
+		}
+
+		float mGain;
+		glm::vec3 mPosition;
+		bool mInited = false, mPlaying = false;
+
+		ProceduralCallback mCallback = nullptr;
+		void* mUserData = nullptr;
+		unsigned int mSampleRate = 48000;
+		ProceduralParams mParams;
+
+		/* AL data */
+		ALuint mSource = 0;
+		ALuint mBuffer = 0;
+	};
+
+	// Ready-made generator: one oscillator through an envelope.
+	// Pass it as user data together with Voice::render.
+	// PP_FREQUENCY and PP_GAIN control pitch and loudness, note on/off drive the envelope.
+	struct Voice {
+	public:
+		Voice(OscillatorShape tShape = OS_SINE, Envelope tEnvelope = Envelope())
+			: oscillator(tShape), envelope(tEnvelope) { }
+
+		static void render(float* tOut, unsigned int tFrames, unsigned int tSampleRate,
+			const ProceduralParams& tParams, void* tUserData) {
+			Voice* self = static_cast<Voice*>(tUserData);
+			uint32_t ons = tParams.getNoteOns(), offs = tParams.getNoteOffs();
+			if(ons != self->mNoteOns) self->envelope.noteOn();
+			if(offs != self->mNoteOffs) self->envelope.noteOff();
+			self->mNoteOns = ons;
+			self->mNoteOffs = offs;
+			self->oscillator.render(tOut, tFrames, tParams.get(PP_FREQUENCY), tSampleRate, tParams.get(PP_GAIN));
+			self->envelope.apply(tOut, tFrames, tSampleRate);
+		}
+
+		Oscillator oscillator;
+		Envelope envelope;
+	private:
+		uint32_t mNoteOns = 0, mNoteOffs = 0;
+	};
+
+}
+
+#endif // !FS_OAL_PROCEDURAL
@@ -2,12 +2,7 @@
 #define FS_OAL_SOURCE
 
 #include "defenitions.hpp"
-#define DR_WAV_IMPLEMENTATION
-#include "dr_libs/dr_wav.hpp"
-#define DR_MP3_IMPLEMENTATION
-#include "dr_libs/dr_mp3.hpp"
-#define DR_FLAC_IMPLEMENTATION
-#include "dr_libs/dr_flac.hpp"
+#include "clip.hpp"
 
 namespace FSOAL {
 
@@ -25,18 +20,19 @@ namespace FSOAL {
 
 		bool initialize() {
 			if(!oalGlobalInitState) return false;
-			alGetError(); // clear error code 
-			alGenBuffers(1, &mBuffer);
-			alGenSources(1, &mSource);
-			return alGetError() != AL_NO_ERROR;
+			oalGetError(); // clear error code 
+			oalGenBuffers(1, &mBuffer);
+			oalGenSources(1, &mSource);
+			FSOAL_STAT(if(mSource) StatsCounters::sourceCreated(mSource));
+			return oalGetError() != AL_NO_ERROR;
 		}
 		bool initialize(std::string tSrc, float tGain = 1.0f, bool tLooping = false) {
 			if(!oalGlobalInitState) return false;
 			if(mInited) remove();
-			alGetError(); // clear error code 
-			alGenBuffers(1, &mBuffer);
-			alGenSources(1, &mSource);
-			if(alGetError() != AL_NO_ERROR) return false;
+			oalGetError(); // clear error code 
+			oalGenSources(1, &mSource);
+			if(oalGetError() != AL_NO_ERROR) return false;
+			FSOAL_STAT(StatsCounters::sourceCreated(mSource));
 			load(tSrc);
 			setGain(tGain);
 			setLooping(tLooping);
@@ -45,10 +41,10 @@ namespace FSOAL {
 		Source* init(std::string tSrc, float tGain = 1.0f, bool tLooping = false) {
 			if(!oalGlobalInitState) return nullptr;
 			if(mInited) remove();
-			alGetError(); // clear error code 
-			alGenBuffers(1, &mBuffer);
-			alGenSources(1, &mSource);
-			if(alGetError() != AL_NO_ERROR) return nullptr;
+			oalGetError(); // clear error code 
+			oalGenSources(1, &mSource);
+			if(oalGetError() != AL_NO_ERROR) return nullptr;
+			FSOAL_STAT(StatsCounters::sourceCreated(mSource));
 			load(tSrc);
 			setGain(tGain);
 			setLooping(tLooping);
@@ -58,43 +54,57 @@ namespace FSOAL {
 		void remove() {
 			if(!oalGlobalInitState) return;
 			stop();
-			alDeleteSources(1, &mSource);
-			alDeleteBuffers(1, &mBuffer);
+			if(mSource) {
+				FSOAL_STAT(StatsCounters::sourceDeleted(mSource));
+				oalDeleteSources(1, &mSource);
+				mSource = 0;
+			}
+			if(!mClip) oalDeleteBuffers(1, &mBuffer);
+			mClip.reset();
+			mBuffer = 0;
 			mInited = false;
 		}
 
 		bool load(std::string tSrc) {
 			if(!oalGlobalInitState) return false;
-			if(!_loadWav(tSrc.c_str()))
-				if(!_loadMP3(tSrc.c_str())) 
-					if (!_loadFLAC(tSrc.c_str())) {
-						LOG_WARN("Couldn't load unsupported audio format at " + tSrc);
-						return false;
-					}
-			alSourcef(mSource, AL_PITCH, mPitch);
-			alSource3f(mSource, AL_POSITION, mPosition.x, mPosition.y, mPosition.z);
-			alSource3f(mSource, AL_VELOCITY, mVelocity.x, mVelocity.y, mVelocity.z);
-			alSourcei(mSource, AL_LOOPING, mLooping ? AL_TRUE : AL_FALSE);
-			alSourcei(mSource, AL_BUFFER, mBuffer);
-			alSourcef(mSource, AL_MIN_GAIN, 0);
-			alSourcef(mSource, AL_GAIN, mGain);
+			return load(Clip::load(tSrc));
+		}
+		// Plays already loaded clip (sharing its buffer).
+		bool load(std::shared_ptr<Clip> tClip) {
+			if(!oalGlobalInitState || !tClip) return false;
+			stop();
+			oalSourcei(mSource, AL_BUFFER, 0);
+			if(!mClip && mBuffer) oalDeleteBuffers(1, &mBuffer);
+			mClip = tClip;
+			mBuffer = mClip->getBuffer();
+			mFormat = mClip->getFormat();
+			mChannels = mClip->getChannels();
+			mSampleRate = mClip->getSampleRate();
+			mBitsPerSample = mClip->getBitsPerSample();
+			oalSourcef(mSource, AL_PITCH, mPitch);
+			oalSource3f(mSource, AL_POSITION, mPosition.x, mPosition.y, mPosition.z);
+			oalSource3f(mSource, AL_VELOCITY, mVelocity.x, mVelocity.y, mVelocity.z);
+			oalSourcei(mSource, AL_LOOPING, mLooping ? AL_TRUE : AL_FALSE);
+			oalSourcei(mSource, AL_BUFFER, mBuffer);
+			oalSourcef(mSource, AL_MIN_GAIN, 0);
+			oalSourcef(mSource, AL_GAIN, mGain);
 			return true;
 		}
 
 		void play() {
 			if(!oalGlobalInitState || !mInited) return;
 			mPlaying = true;
-			alSourcePlay(mSource);
+			oalSourcePlay(mSource);
 		}
 		void stop() {
 			if(!oalGlobalInitState || !mInited) return;
 			mPlaying = false;
-			alSourceStop(mSource);
+			oalSourceStop(mSource);
 		}
 		void pause() {
 			if(!oalGlobalInitState || !mInited) return;
 			mPlaying = !mPlaying;
-			alSourcePause(mSource);
+			oalSourcePause(mSource);
 		}
 		void resume() {
 			if(!oalGlobalInitState || !mInited) return;
@@ -115,11 +125,11 @@ namespace FSOAL {
 
 		glm::vec3 getPostion() const { return mPosition; }
 		glm::vec3 getVelocity() const { return mVelocity; }
-		float getGain() { mMuted = false; return mGain; }
+		float getGain() const { return mGain; }
 		float getPitch() const { return mPitch; }
 		float getOffsetInSamples() const {
 			float offset = 0;
-			alGetSourcef(mSource, AL_SAMPLE_OFFSET, &offset);
+			oalGetSourcef(mSource, AL_SAMPLE_OFFSET, &offset);
 			return offset;
 		}
 		float getOffset() const {
@@ -131,9 +141,9 @@ namespace FSOAL {
 			ALint channels;
 			ALint bits;
 
-			alGetBufferi(mBuffer, AL_SIZE, &sizeInBytes);
-			alGetBufferi(mBuffer, AL_CHANNELS, &channels);
-			alGetBufferi(mBuffer, AL_BITS, &bits);
+			oalGetBufferi(mBuffer, AL_SIZE, &sizeInBytes);
+			oalGetBufferi(mBuffer, AL_CHANNELS, &channels);
+			oalGetBufferi(mBuffer, AL_BITS, &bits);
 
 			return sizeInBytes * 8.f / (channels * bits);
 		}
@@ -141,7 +151,7 @@ namespace FSOAL {
 			if(!oalGlobalInitState || !mInited) return 0;
 
 			ALint frequency;
-			alGetBufferi(mBuffer, AL_FREQUENCY, &frequency);
+			oalGetBufferi(mBuffer, AL_FREQUENCY, &frequency);
 
 			return (float)getDurationInSamples() / (float)frequency;
 		}
@@ -149,62 +159,64 @@ namespace FSOAL {
 		bool isPlaying() const { return mPlaying; }
 		bool isInitialized() const { return mInited; }
 		bool isMuted() const { return mMuted; }
+		ALuint getHandle() const { return mSource; }
+		const std::shared_ptr<Clip>& getClip() const { return mClip; }
 
 		Source* setPostion(glm::vec3 tPos) {
 			if(!oalGlobalInitState) return this;
 			mPosition = tPos;
-			alSource3f(mSource, AL_POSITION, mPosition.x, mPosition.y, mPosition.z);
+			oalSource3f(mSource, AL_POSITION, mPosition.x, mPosition.y, mPosition.z);
 			return this;
 		}
 		Source* setPostion(float tX, float tY, float tZ) {
 			if(!oalGlobalInitState) return this;
 			mPosition = glm::vec3(tX,tY,tZ);
-			alSource3f(mSource, AL_POSITION, mPosition.x, mPosition.y, mPosition.z);
+			oalSource3f(mSource, AL_POSITION, mPosition.x, mPosition.y, mPosition.z);
 			return this;
 		}
 		Source* setVelocity(glm::vec3 tVel) {
 			if(!oalGlobalInitState) return this;
 			mVelocity = tVel;
-			alSource3f(mSource, AL_VELOCITY, mVelocity.x, mVelocity.y, mVelocity.z);
+			oalSource3f(mSource, AL_VELOCITY, mVelocity.x, mVelocity.y, mVelocity.z);
 			return this;
 		}
 		Source* setVelocity(float tX, float tY, float tZ) {
 			if(!oalGlobalInitState) return this;
 			mVelocity = glm::vec3(tX, tY, tZ);
-			alSource3f(mSource, AL_VELOCITY, mVelocity.x, mVelocity.y, mVelocity.z);
+			oalSource3f(mSource, AL_VELOCITY, mVelocity.x, mVelocity.y, mVelocity.z);
 			return this;
 		}
 		Source* setGain(float tGain) {
 			if(!oalGlobalInitState) return this;
 			mGain = tGain;
-			alSourcef(mSource, AL_GAIN, mGain);
+			oalSourcef(mSource, AL_GAIN, mGain);
 			return this;
 		}
 		Source* setTempGain(float tGain) {
 			if(!oalGlobalInitState) return this;
-			alSourcef(mSource, AL_GAIN, tGain);
+			oalSourcef(mSource, AL_GAIN, tGain);
 			return this;
 		}
 		Source* setPitch(float tPitch) {
 			if(!oalGlobalInitState) return this;
 			mPitch = tPitch;
-			alSourcef(mSource, AL_PITCH, mPitch);
+			oalSourcef(mSource, AL_PITCH, mPitch);
 			return this;
 		}
 		Source* setTempPitch(float tPitch) {
 			if(!oalGlobalInitState) return this;
-			alSourcef(mSource, AL_PITCH, tPitch);
+			oalSourcef(mSource, AL_PITCH, tPitch);
 			return this;
 		}
 		Source* setLooping(bool tLoop) {
 			if(!oalGlobalInitState) return this;
 			mLooping = tLoop;
-			alSourcei(mSource, AL_LOOPING, mLooping ? AL_TRUE : AL_FALSE);
+			oalSourcei(mSource, AL_LOOPING, mLooping ? AL_TRUE : AL_FALSE);
 			return this;
 		}
 		Source* setOffset(float tSec) {
 			if(!oalGlobalInitState) return this;
-			alSourcef(mSource, AL_SEC_OFFSET, tSec);
+			oalSourcef(mSource, AL_SEC_OFFSET, tSec);
 			return this;
 		}
 
@@ -220,6 +232,7 @@ namespace FSOAL {
 		ALuint mSource = 0;
 		ALuint mBuffer = 0;
 		ALenum mFormat = 0;
+		std::shared_ptr<Clip> mClip;
 
 		/* File info */
 		unsigned short mChannels = 0;
@@ -227,104 +240,6 @@ namespace FSOAL {
 		unsigned short mBitsPerSample = 0;
 
 	private:
-		bool _loadWav(const char* tSrc) {
-			drwav wav;
-			if(!drwav_init_file(&wav, tSrc, NULL)) {
-				return false;
-			}
-
-			mChannels = wav.channels;
-			mSampleRate = wav.sampleRate;
-			mBitsPerSample = wav.bitsPerSample;
-
-			size_t totalFrameCount = wav.totalPCMFrameCount * wav.channels;
-			std::vector<int16_t> soundData = std::vector<int16_t>(totalFrameCount);
-
-			drwav_read_pcm_frames_s16(&wav, wav.totalPCMFrameCount, soundData.data());
-			drwav_uninit(&wav);
-
-			if(mChannels == 1) {
-				if(mBitsPerSample == 8) mFormat = AL_FORMAT_MONO8;
-				else if(mBitsPerSample == 16) mFormat = AL_FORMAT_MONO16;
-			}
-			else if(mChannels == 2) {
-				if(mBitsPerSample == 8) mFormat = AL_FORMAT_STEREO8;
-				else if(mBitsPerSample == 16) mFormat = AL_FORMAT_STEREO16;
-			}
-			else {
-				LOG_WARN("Unsupported audio: " + std::to_string(static_cast<int>(mChannels)) +
-					" channels | " + std::to_string(static_cast<int>(mSampleRate)).c_str() + " sample rate");
-				mFormat = AL_FORMAT_STEREO16;
-			}
-
-			alGetError(); // clear error code 
-			alBufferData(mBuffer, mFormat, soundData.data(), static_cast<ALsizei>(soundData.size() * sizeof(int16_t)), mSampleRate);
-			soundData.clear(); // erase the sound in RAM
-			return alGetError() == AL_NO_ERROR;
-		}
-		bool _loadMP3(const char* tSrc) {
-			drmp3 mp3;
-			if (!drmp3_init_file(&mp3, tSrc, NULL)) {
-				return false;
-			}
-
-			mChannels = mp3.channels;
-			mSampleRate = mp3.sampleRate;
-			mBitsPerSample = 16;
-
-			size_t totalFrameCount = drmp3_get_pcm_frame_count(&mp3);
-			std::vector<int16_t> soundData = std::vector<int16_t>(totalFrameCount * mp3.channels);
-
-			drmp3_read_pcm_frames_s16(&mp3, totalFrameCount, soundData.data());
-			drmp3_uninit(&mp3);
-
-			if(mChannels == 1)
-				mFormat = AL_FORMAT_MONO16;
-			else if(mChannels == 2)
-				mFormat = AL_FORMAT_STEREO16;
-			else {
-				LOG_WARN("Unsupported audio: " + std::to_string(static_cast<int>(mChannels)) +
-					" channels | " + std::to_string(static_cast<int>(mSampleRate)) + " sample rate");
-				mFormat = AL_FORMAT_STEREO16;
-			}
-
-			alGetError(); // clear error code 
-			alBufferData(mBuffer, mFormat, soundData.data(), static_cast<ALsizei>(soundData.size() * sizeof(int16_t)), mSampleRate);
-			soundData.clear(); // erase the sound in RAM
-
-			return alGetError() == AL_NO_ERROR;
-		}
-		bool _loadFLAC(const char* tSrc) {
-			drflac* flac = drflac_open_file(tSrc, NULL);
-			if (!flac) {
-				return false;
-			}
-
-			mChannels = flac->channels;
-			mSampleRate = flac->sampleRate;
-			mBitsPerSample = 16;
-
-			size_t totalFrameCount = flac->totalPCMFrameCount * flac->channels;
-			std::vector<int16_t> soundData = std::vector<int16_t>(totalFrameCount);
-
-			drflac_read_pcm_frames_s16(flac, flac->totalPCMFrameCount, soundData.data());
-			drflac_close(flac);
-
-			if (mChannels == 1)
-				mFormat = AL_FORMAT_MONO16;
-			else if (mChannels == 2)
-				mFormat = AL_FORMAT_STEREO16;
-			else {
-				LOG_WARN("Unsupported audio: " + std::to_string(static_cast<int>(mChannels)) +
-					" channels | " + std::to_string(static_cast<int>(mSampleRate)) + " sample rate");
-				mFormat = AL_FORMAT_STEREO16;
-			}
-
-			alGetError(); // clear error code 
-			alBufferData(mBuffer, mFormat, soundData.data(), static_cast<ALsizei>(soundData.size() * sizeof(int16_t)), mSampleRate);
-			soundData.clear(); // erase the sound in RAM
-			return alGetError() == AL_NO_ERROR;
-		}
 		float samplesToSeconds(size_t tSamples, int tSampleRate) {
 			return tSamples / (float)tSampleRate;
 		}
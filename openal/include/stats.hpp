@@ -0,0 +1,162 @@
+#ifndef FS_OAL_STATS
+#define FS_OAL_STATS
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <al.h>
+#include <alc.h>
+#include <alext.h>
+#include <efx.h>
+
+// Runtime counters of the audio package.
+// Define FSOAL_NO_STATS (before any FSOAL header) to compile all of them out,
+// or FSOAL_NO_AL_CALL_STATS to keep everything but AL call counting.
+// Only AL calls made by the package (through the oal* wrappers in defenitions.hpp) are counted.
+
+namespace FSOAL {
+
+	// Copy of all counters at one moment.
+	// Per frame values describe the last frame closed with statsFrame().
+	struct Stats {
+		bool enabled = false;
+		uint64_t frame = 0;
+		uint32_t liveSources = 0;
+		// Sources AL reports as playing (streams, procedural sources and cluster voices included).
+		uint32_t playingVoices = 0;
+		uint32_t alCallsLastFrame = 0;
+		uint64_t alCallsTotal = 0;
+		uint32_t clipsDecoded = 0;
+		double lastClipDecodeMs = 0, maxClipDecodeMs = 0, averageClipDecodeMs = 0;
+		// Time spent decoding streamed tracks, in total.
+		double streamDecodeMs = 0;
+		// PCM data uploaded to AL buffers that are still alive.
+		uint64_t bufferBytes = 0;
+		uint32_t streamUnderruns = 0;
+		// Jobs waiting for a worker thread (decoding, ray batches).
+		uint32_t loadQueueDepth = 0;
+	};
+
+#ifndef FSOAL_NO_STATS
+	#define FSOAL_STAT(tExpr) tExpr
+
+	enum StatCounter {
+		SC_LIVE_SOURCES = 0,
+		SC_AL_CALLS,
+		SC_BUFFER_BYTES,
+		SC_UNDERRUNS,
+		SC_LOAD_QUEUE,
+		SC_CLIPS_DECODED,
+		SC_CLIP_DECODE_NS,
+		SC_STREAM_DECODE_NS,
+
+		SC_COUNT
+	};
+
+	// Storage behind Stats. Counters are relaxed atomics, so updating them never blocks.
+	// Only source registration takes a lock (once per source lifetime).
+	class StatsCounters {
+	public:
+		static StatsCounters& get() {
+			static StatsCounters instance;
+			return instance;
+		}
+
+		static void add(StatCounter tCounter, int64_t tValue) {
+			get().mCounters[tCounter].fetch_add(tValue, std::memory_order_relaxed);
+		}
+		static void alCall() { add(SC_AL_CALLS, 1); }
+		static void clipDecoded(uint64_t tNanoseconds) {
+			StatsCounters& s = get();
+			add(SC_CLIPS_DECODED, 1);
+			add(SC_CLIP_DECODE_NS, static_cast<int64_t>(tNanoseconds));
+			s.mLastClipNs.store(tNanoseconds, std::memory_order_relaxed);
+			uint64_t max = s.mMaxClipNs.load(std::memory_order_relaxed);
+			while(tNanoseconds > max && !s.mMaxClipNs.compare_exchange_weak(max, tNanoseconds, std::memory_order_relaxed)) { }
+		}
+		static void sourceCreated(ALuint tSource) {
+			StatsCounters& s = get();
+			add(SC_LIVE_SOURCES, 1);
+			std::lock_guard<std::mutex> lock(s.mMutex);
+			s.mSources.push_back(tSource);
+		}
+		static void sourceDeleted(ALuint tSource) {
+			StatsCounters& s = get();
+			add(SC_LIVE_SOURCES, -1);
+			std::lock_guard<std::mutex> lock(s.mMutex);
+			auto it = std::find(s.mSources.begin(), s.mSources.end(), tSource);
+			if(it != s.mSources.end()) {
+				*it = s.mSources.back();
+				s.mSources.pop_back();
+			}
+		}
+
+		// Closes current frame.
+		void frame() {
+			uint64_t calls = _load(SC_AL_CALLS);
+			mLastFrameCalls.store(calls - mFrameStartCalls.exchange(calls), std::memory_order_relaxed);
+			mFrame.fetch_add(1, std::memory_order_relaxed);
+		}
+		Stats snapshot() {
+			Stats stats;
+			stats.enabled = true;
+			stats.frame = mFrame.load(std::memory_order_relaxed);
+			stats.liveSources = static_cast<uint32_t>(_load(SC_LIVE_SOURCES));
+			stats.alCallsLastFrame = static_cast<uint32_t>(mLastFrameCalls.load(std::memory_order_relaxed));
+			stats.alCallsTotal = _load(SC_AL_CALLS);
+			stats.clipsDecoded = static_cast<uint32_t>(_load(SC_CLIPS_DECODED));
+			stats.lastClipDecodeMs = mLastClipNs.load(std::memory_order_relaxed) / 1e6;
+			stats.maxClipDecodeMs = mMaxClipNs.load(std::memory_order_relaxed) / 1e6;
+			stats.averageClipDecodeMs = stats.clipsDecoded ? _load(SC_CLIP_DECODE_NS) / 1e6 / stats.clipsDecoded : 0;
+			stats.streamDecodeMs = _load(SC_STREAM_DECODE_NS) / 1e6;
+			stats.bufferBytes = _load(SC_BUFFER_BYTES);
+			stats.streamUnderruns = static_cast<uint32_t>(_load(SC_UNDERRUNS));
+			stats.loadQueueDepth = static_cast<uint32_t>(_load(SC_LOAD_QUEUE));
+			// Playing state lives in AL, ask it directly (not counted as AL calls of the frame).
+			if(alcGetCurrentContext()) {
+				std::lock_guard<std::mutex> lock(mMutex);
+				for(ALuint source : mSources) {
+					ALint state = 0;
+					alGetSourcei(source, AL_SOURCE_STATE, &state);
+					if(state == AL_PLAYING) stats.playingVoices++;
+				}
+			}
+			return stats;
+		}
+	private:
+		StatsCounters() {
+			for(auto& c : mCounters) c.store(0, std::memory_order_relaxed);
+		}
+		uint64_t _load(StatCounter tCounter) const {
+			int64_t v = mCounters[tCounter].load(std::memory_order_relaxed);
+			return v > 0 ? static_cast<uint64_t>(v) : 0;
+		}
+
+		std::atomic<int64_t> mCounters[SC_COUNT];
+		std::atomic<uint64_t> mLastClipNs{0}, mMaxClipNs{0};
+		std::atomic<uint64_t> mFrame{0}, mFrameStartCalls{0}, mLastFrameCalls{0};
+		std::mutex mMutex;
+		std::vector<ALuint> mSources;
+	};
+
+	// Call once per game frame, so per frame counters have something to cover.
+	static void statsFrame() { StatsCounters::get().frame(); }
+	static Stats snapshot() { return StatsCounters::get().snapshot(); }
+	#ifndef FSOAL_NO_AL_CALL_STATS
+	static void _countAlCall() { StatsCounters::alCall(); }
+	#else
+	static void _countAlCall() { }
+	#endif
+#else
+	#define FSOAL_STAT(tExpr)
+
+	static void statsFrame() { }
+	static Stats snapshot() { return Stats(); }
+	static void _countAlCall() { }
+#endif
+
+}
+
+#endif // !FS_OAL_STATS
@@ -0,0 +1,377 @@
+#ifndef FS_OAL_STREAM
+#define FS_OAL_STREAM
+
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
+#include "defenitions.hpp"
+#include "decoder.hpp"
+#include "worker.hpp"
+
+namespace FSOAL {
+
+	// Audio file decoded chunk by chunk on worker threads, a few chunks ahead of playback.
+	class Track {
+	public:
+		// Opens the file and decodes first chunks in background.
+		static std::shared_ptr<Track> open(const std::string& tSrc, bool tLooping = false,
+			size_t tChunkFrames = 8192, size_t tChunksAhead = 4) {
+			std::shared_ptr<Track> track(new Track(tSrc, tLooping, tChunkFrames, tChunksAhead));
+			track->mFilling = true;
+			track->mGroup.run([t = track.get()]() {
+				if(!t->mDecoder.open(t->mSrc)) {
+					LOG_WARN("Couldn't stream unsupported audio format at " + t->mSrc);
+					t->mFailed = true;
+					t->mFilling = false;
+					return;
+				}
+				// Loop region from file tags, unless it was set by hand already.
+				if(t->mLoopEnd == 0) {
+					t->mLoopStart = t->mDecoder.getLoopStart();
+					t->mLoopEnd = t->mDecoder.getLoopEnd();
+				}
+				t->mOpened = true;
+				t->_fill();
+			});
+			return track;
+		}
+		~Track() { mGroup.wait(); }
+
+		// Takes next decoded chunk. Returns false if nothing is decoded yet.
+		bool pop(std::vector<int16_t>& tOut) {
+			bool end;
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if(mChunks.empty()) return false;
+				tOut.swap(mChunks.front());
+				mChunks.pop_front();
+				end = mEnd;
+			}
+			if(!end && !mFilling.exchange(true))
+				mGroup.run([this]() { _fill(); });
+			return true;
+		}
+
+		// Decoder is open and first chunk is out (or there is nothing to decode at all).
+		bool isReady() const {
+			if(!mOpened) return false;
+			std::lock_guard<std::mutex> lock(mMutex);
+			return !mChunks.empty() || mEnd;
+		}
+		bool isFailed() const { return mFailed; }
+		// Everything was decoded and taken.
+		bool isFinished() const {
+			if(mFailed) return true;
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mEnd && mChunks.empty();
+		}
+		bool isLooping() const { return mLooping; }
+		// Looping tracks wrap from loop end to loop start inside the decoder, so loops are sample-accurate.
+		void setLooping(bool tLooping) { mLooping = tLooping; }
+		// Overrides loop region read from file (LOOPSTART/LOOPEND tags). Takes effect on next wrap.
+		void setLoopPoints(uint64_t tStart, uint64_t tEnd) {
+			if(tStart >= tEnd) return;
+			mLoopStart = tStart;
+			mLoopEnd = tEnd;
+		}
+		uint64_t getLoopStart() const { return mLoopStart; }
+		uint64_t getLoopEnd() const { return mLoopEnd; }
+
+		const std::string& getPath() const { return mSrc; }
+		// Values below are valid only after isReady().
+		unsigned short getChannels() const { return mDecoder.getChannels(); }
+		unsigned int getSampleRate() const { return mDecoder.getSampleRate(); }
+		uint64_t getFrameCount() const { return mDecoder.getFrameCount(); }
+		float getDuration() const { return getSampleRate() ? static_cast<float>(getFrameCount()) / getSampleRate() : 0; }
+		ALenum getALFormat() const { return mFormat; }
+
+	private:
+		Track(const std::string& tSrc, bool tLooping, size_t tChunkFrames, size_t tChunksAhead)
+			: mSrc(tSrc), mChunkFrames(tChunkFrames), mChunksAhead(tChunksAhead), mLooping(tLooping) { }
+
+		bool _needsFill() {
+			std::lock_guard<std::mutex> lock(mMutex);
+			return !mEnd && mChunks.size() < mChunksAhead;
+		}
+		void _fill() {
+			if(mFormat == 0) mFormat = mDecoder.getALFormat();
+			unsigned short channels = mDecoder.getChannels();
+			do {
+				while(_needsFill()) {
+					std::vector<int16_t> chunk(mChunkFrames * channels);
+					uint64_t frames = 0;
+					// Set after a wrap until something is read, so an empty loop can't spin forever.
+					bool wrapped = false;
+					while(frames < mChunkFrames) {
+						uint64_t want = mChunkFrames - frames;
+						// Without loop end (length unknown until decoded) the loop wraps at end of file.
+						uint64_t loopEnd = mLoopEnd > mLoopStart ? mLoopEnd.load() : UINT64_MAX;
+						// Don't read past loop end, so the wrap lands on the exact frame.
+						if(mLooping && loopEnd > mDecoder.getCursor()) want = std::min<uint64_t>(want, loopEnd - mDecoder.getCursor());
+						FSOAL_STAT(auto start = std::chrono::steady_clock::now());
+						uint64_t read = mDecoder.read(chunk.data() + frames * channels, want);
+						FSOAL_STAT(StatsCounters::add(SC_STREAM_DECODE_NS, std::chrono::duration_cast<std::chrono::nanoseconds>(
+							std::chrono::steady_clock::now() - start).count()));
+						frames += read;
+						if(read > 0) wrapped = false;
+						if(read > 0 && (!mLooping || mDecoder.getCursor() < loopEnd)) continue;
+						if(!mLooping || wrapped || !mDecoder.seek(mLoopStart)) break;
+						wrapped = true;
+					}
+					chunk.resize(static_cast<size_t>(frames * channels));
+					std::lock_guard<std::mutex> lock(mMutex);
+					if(frames > 0) mChunks.push_back(std::move(chunk));
+					if(frames < mChunkFrames) mEnd = true;
+				}
+				mFilling = false;
+			} while(_needsFill() && !mFilling.exchange(true));
+		}
+
+		std::string mSrc;
+		size_t mChunkFrames, mChunksAhead;
+		std::atomic<bool> mLooping;
+		std::atomic<bool> mOpened{false}, mFailed{false}, mFilling{false};
+		std::atomic<uint64_t> mLoopStart{0}, mLoopEnd{0};
+		bool mEnd = false;
+		ALenum mFormat = 0;
+
+		Decoder mDecoder;
+		std::deque<std::vector<int16_t>> mChunks;
+		mutable std::mutex mMutex;
+		WorkGroup mGroup;
+	};
+
+	// Source that plays tracks through a small queue of AL buffers.
+	// Tracks queued one after another play back-to-back on the same AL source, without a gap.
+	// update() only uploads already decoded chunks, it never decodes.
+	class Stream {
+	public:
+		Stream(float tGain = 1) : mGain(tGain) { }
+		~Stream() { remove(); }
+
+		bool initialize(size_t tBufferCount = 4) {
+			if(!oalGlobalInitState) return false;
+			if(mInited) remove();
+			oalGetError(); // clear error code
+			oalGenSources(1, &mSource);
+			mBuffers.resize(tBufferCount);
+			oalGenBuffers(static_cast<ALsizei>(tBufferCount), mBuffers.data());
+			if(oalGetError() != AL_NO_ERROR) return false;
+			FSOAL_STAT(StatsCounters::sourceCreated(mSource));
+			mFree.assign(mBuffers.begin(), mBuffers.end());
+			mBufferBytes.assign(tBufferCount, 0);
+			oalSourcef(mSource, AL_GAIN, mGain);
+			mInited = true;
+			return true;
+		}
+		void remove() {
+			if(!oalGlobalInitState || !mInited) return;
+			clear();
+			FSOAL_STAT(StatsCounters::sourceDeleted(mSource));
+			oalDeleteSources(1, &mSource);
+			oalDeleteBuffers(static_cast<ALsizei>(mBuffers.size()), mBuffers.data());
+			FSOAL_STAT(for(size_t bytes : mBufferBytes) StatsCounters::add(SC_BUFFER_BYTES, -static_cast<int64_t>(bytes)));
+			mBufferBytes.clear();
+			mBuffers.clear();
+			mFree.clear();
+			mInited = false;
+		}
+
+		// Appends track after everything already queued.
+		void enqueue(std::shared_ptr<Track> tTrack) {
+			if(tTrack) mTracks.push_back(std::move(tTrack));
+		}
+		// Stops playback and drops all queued tracks.
+		void clear() {
+			if(!mInited) return;
+			stop();
+			mTracks.clear();
+		}
+
+		void update() {
+			if(!oalGlobalInitState || !mInited) return;
+			// Take back played buffers.
+			ALint processed = 0;
+			oalGetSourcei(mSource, AL_BUFFERS_PROCESSED, &processed);
+			while(processed-- > 0 && !mQueued.empty()) {
+				ALuint buffer = 0;
+				oalSourceUnqueueBuffers(mSource, 1, &buffer);
+				if(mQueued.front().track == mCurrent) mPlayedFrames += mQueued.front().frames;
+				mQueued.pop_front();
+				mFree.push_back(buffer);
+				if(!mQueued.empty() && mQueued.front().track != mCurrent) {
+					mCurrent = mQueued.front().track;
+					mPlayedFrames = 0;
+				}
+			}
+			// Upload decoded chunks.
+			while(!mFree.empty() && !mTracks.empty()) {
+				std::shared_ptr<Track>& track = mTracks.front();
+				if(track->isFailed()) { mTracks.pop_front(); continue; }
+				if(!track->isReady()) break;
+				// AL can't queue buffers of different formats, so wait for the queue to drain.
+				if(!mQueued.empty() && (track->getALFormat() != mQueuedFormat || track->getSampleRate() != mQueuedRate)) break;
+				if(!track->pop(mScratch)) {
+					if(track->isFinished()) { mTracks.pop_front(); continue; }
+					break;
+				}
+				ALuint buffer = mFree.back();
+				mFree.pop_back();
+				oalBufferData(buffer, track->getALFormat(), mScratch.data(),
+					static_cast<ALsizei>(mScratch.size() * sizeof(int16_t)), static_cast<ALsizei>(track->getSampleRate()));
+				_setBufferBytes(buffer, mScratch.size() * sizeof(int16_t));
+				oalSourceQueueBuffers(mSource, 1, &buffer);
+				// Chunk stays with the queued buffer, so what is playing can be peeked at.
+				mQueued.push_back({ track, mScratch.size() / track->getChannels(), track->getChannels(), std::move(mScratch) });
+				mQueuedFormat = track->getALFormat();
+				mQueuedRate = track->getSampleRate();
+				if(!mCurrent || mQueued.size() == 1) {
+					if(mCurrent != track) mPlayedFrames = 0;
+					mCurrent = track;
+				}
+			}
+			if(!mPlaying) return;
+			// Restart source if it ran dry while there still is something to play.
+			ALint state = 0;
+			oalGetSourcei(mSource, AL_SOURCE_STATE, &state);
+			if(state == AL_PLAYING) return;
+			if(!mQueued.empty()) {
+				if(state == AL_STOPPED) {
+					mUnderruns++;
+					FSOAL_STAT(StatsCounters::add(SC_UNDERRUNS, 1));
+				}
+				oalSourcePlay(mSource);
+			}
+			else if(mTracks.empty()) mPlaying = false;
+		}
+
+		void play() {
+			if(!oalGlobalInitState || !mInited) return;
+			mPlaying = true;
+			update();
+			if(!mQueued.empty()) oalSourcePlay(mSource);
+		}
+		// Drops audio already handed to AL, queued tracks go on from where decoding is.
+		// Nothing is current until play() queues audio again, position then counts from the resumed chunk.
+		void stop() {
+			if(!oalGlobalInitState || !mInited) return;
+			mPlaying = false;
+			oalSourceStop(mSource);
+			oalSourcei(mSource, AL_BUFFER, 0);
+			mFree.assign(mBuffers.begin(), mBuffers.end());
+			mQueued.clear();
+			mCurrent.reset();
+			mPlayedFrames = 0;
+		}
+		void pause() {
+			if(!oalGlobalInitState || !mInited) return;
+			mPlaying = false;
+			oalSourcePause(mSource);
+		}
+
+		// Track being heard right now.
+		std::shared_ptr<Track> getCurrent() const { return mCurrent ? mCurrent : (mTracks.empty() ? nullptr : mTracks.front()); }
+		// Position inside current track in frames.
+		uint64_t getPositionInFrames() const {
+			if(!mCurrent) return 0;
+			ALint offset = 0;
+			if(!mQueued.empty() && mQueued.front().track == mCurrent)
+				oalGetSourcei(mSource, AL_SAMPLE_OFFSET, &offset);
+			uint64_t position = mPlayedFrames + static_cast<uint64_t>(offset);
+			uint64_t end = mCurrent->getLoopEnd(), start = mCurrent->getLoopStart();
+			// After the first pass position cycles through the loop region.
+			if(mCurrent->isLooping() && end > start && position >= end)
+				position = start + (position - end) % (end - start);
+			return position;
+		}
+		float getPosition() const {
+			return mCurrent && mCurrent->getSampleRate() ? static_cast<float>(getPositionInFrames()) / mCurrent->getSampleRate() : 0;
+		}
+		// Seconds left in current track (looping tracks never end).
+		float getRemaining() const {
+			std::shared_ptr<Track> track = getCurrent();
+			if(!track || !track->isReady()) return 1e9f;
+			if(track->isLooping()) return 1e9f;
+			return track->getDuration() - (track == mCurrent ? getPosition() : 0.f);
+		}
+		// Writes mono mix of what the source plays from now on (up to tFrames, in [-1;1]).
+		// Returns amount of frames written, it's less than asked if not enough is queued yet.
+		size_t peek(float* tOut, size_t tFrames, unsigned int* tSampleRate = nullptr) const {
+			if(!oalGlobalInitState || !mInited || mQueued.empty()) return 0;
+			ALint offset = 0;
+			oalGetSourcei(mSource, AL_SAMPLE_OFFSET, &offset);
+			uint64_t skip = offset > 0 ? static_cast<uint64_t>(offset) : 0;
+			size_t written = 0;
+			for(const QueuedBuffer& queued : mQueued) {
+				if(skip >= queued.frames) { skip -= queued.frames; continue; }
+				unsigned short channels = queued.channels;
+				float scale = 1.f / (32768.f * channels);
+				for(uint64_t f = skip; f < queued.frames && written < tFrames; f++, written++) {
+					int sum = 0;
+					for(unsigned short c = 0; c < channels; c++) sum += queued.pcm[f * channels + c];
+					tOut[written] = sum * scale;
+				}
+				skip = 0;
+				if(written == tFrames) break;
+			}
+			if(tSampleRate) *tSampleRate = mQueuedRate;
+			return written;
+		}
+		unsigned int getUnderruns() const { return mUnderruns; }
+		bool isPlaying() const { return mPlaying; }
+		bool isInitialized() const { return mInited; }
+		ALuint getHandle() const { return mSource; }
+		float getGain() const { return mGain; }
+
+		Stream* setGain(float tGain) {
+			if(!oalGlobalInitState) return this;
+			mGain = tGain;
+			oalSourcef(mSource, AL_GAIN, mGain);
+			return this;
+		}
+
+	private:
+		// Keeps resident byte count of every buffer, for stats.
+		void _setBufferBytes(ALuint tBuffer, size_t tBytes) {
+			for(size_t i = 0; i < mBuffers.size(); i++) {
+				if(mBuffers[i] != tBuffer) continue;
+				FSOAL_STAT(StatsCounters::add(SC_BUFFER_BYTES, static_cast<int64_t>(tBytes) - static_cast<int64_t>(mBufferBytes[i])));
+				mBufferBytes[i] = tBytes;
+				return;
+			}
+		}
+
+		struct QueuedBuffer {
+			std::shared_ptr<Track> track;
+			uint64_t frames;
+			unsigned short channels;
+			std::vector<int16_t> pcm;
+		};
+
+		float mGain;
+		bool mInited = false, mPlaying = false;
+		unsigned int mUnderruns = 0;
+
+		/* AL data */
+		ALuint mSource = 0;
+		std::vector<ALuint> mBuffers;
+		std::vector<ALuint> mFree;
+		std::vector<size_t> mBufferBytes;
+		ALenum mQueuedFormat = 0;
+		unsigned int mQueuedRate = 0;
+
+		/* Playback state */
+		std::deque<std::shared_ptr<Track>> mTracks;
+		std::deque<QueuedBuffer> mQueued;
+		std::shared_ptr<Track> mCurrent;
+		uint64_t mPlayedFrames = 0;
+		std::vector<int16_t> mScratch;
+	};
+
+}
+
+#endif // !FS_OAL_STREAM
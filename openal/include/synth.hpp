@@ -0,0 +1,195 @@
+#ifndef FS_OAL_SYNTH
+#define FS_OAL_SYNTH
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define FSOAL_SYNTH_SSE2
+	#include <emmintrin.h>
+#endif
+
+// Oscillators and envelopes for procedural sources.
+// Everything renders mono float blocks and is safe to call from the AL mixer thread
+// (no allocations, no locks).
+
+namespace FSOAL {
+
+	enum OscillatorShape {
+		OS_SINE = 0,
+		OS_SAW,
+		OS_SQUARE,
+		OS_TRIANGLE,
+		OS_NOISE
+	};
+
+	struct Oscillator {
+	public:
+		Oscillator(OscillatorShape tShape = OS_SINE) : mShape(tShape) { }
+
+		// Writes (or adds, if tAdd) given amount of frames to tOut.
+		void render(float* tOut, size_t tFrames, float tFrequency, unsigned int tSampleRate, float tGain = 1, bool tAdd = false) {
+			float inc = tFrequency / static_cast<float>(tSampleRate);
+			size_t i = 0;
+#ifdef FSOAL_SYNTH_SSE2
+			const __m128 vInc4 = _mm_set1_ps(inc * 4.f);
+			const __m128 vGain = _mm_set1_ps(tGain);
+			__m128 vPhase = _mm_add_ps(_mm_set1_ps(mPhase), _mm_mul_ps(_mm_set1_ps(inc), _mm_setr_ps(0, 1, 2, 3)));
+			__m128i vSeed = _mm_setr_epi32(static_cast<int>(mSeed), static_cast<int>(mSeed * 747796405u + 1u),
+				static_cast<int>(mSeed * 2891336453u + 3u), static_cast<int>(mSeed * 277803737u + 5u));
+			for(; i + 4 <= tFrames; i += 4) {
+				vPhase = _wrap(vPhase);
+				__m128 v;
+				switch(mShape) {
+				case OS_SAW: v = _mm_sub_ps(_mm_add_ps(vPhase, vPhase), _mm_set1_ps(1.f)); break;
+				case OS_SQUARE: {
+					__m128 high = _mm_cmplt_ps(vPhase, _mm_set1_ps(0.5f));
+					v = _mm_or_ps(_mm_and_ps(high, _mm_set1_ps(1.f)), _mm_andnot_ps(high, _mm_set1_ps(-1.f)));
+					break;
+				}
+				case OS_TRIANGLE:
+					v = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(4.f), _abs(_mm_sub_ps(vPhase, _mm_set1_ps(0.5f)))), _mm_set1_ps(1.f));
+					break;
+				case OS_NOISE: {
+					// xorshift32 in every lane.
+					vSeed = _mm_xor_si128(vSeed, _mm_slli_epi32(vSeed, 13));
+					vSeed = _mm_xor_si128(vSeed, _mm_srli_epi32(vSeed, 17));
+					vSeed = _mm_xor_si128(vSeed, _mm_slli_epi32(vSeed, 5));
+					v = _mm_mul_ps(_mm_cvtepi32_ps(vSeed), _mm_set1_ps(1.f / 2147483648.f));
+					break;
+				}
+				default: v = _sine(vPhase); break;
+				}
+				v = _mm_mul_ps(v, vGain);
+				if(tAdd) v = _mm_add_ps(v, _mm_loadu_ps(tOut + i));
+				_mm_storeu_ps(tOut + i, v);
+				vPhase = _mm_add_ps(vPhase, vInc4);
+			}
+			mPhase = _mm_cvtss_f32(_wrap(vPhase));
+			mSeed = static_cast<uint32_t>(_mm_cvtsi128_si32(vSeed));
+#endif
+			for(; i < tFrames; i++) {
+				float v;
+				switch(mShape) {
+				case OS_SAW: v = mPhase * 2.f - 1.f; break;
+				case OS_SQUARE: v = mPhase < 0.5f ? 1.f : -1.f; break;
+				case OS_TRIANGLE: v = 4.f * std::fabs(mPhase - 0.5f) - 1.f; break;
+				case OS_NOISE:
+					mSeed ^= mSeed << 13;
+					mSeed ^= mSeed >> 17;
+					mSeed ^= mSeed << 5;
+					v = static_cast<float>(static_cast<int32_t>(mSeed)) / 2147483648.f;
+					break;
+				default: v = _sine(mPhase); break;
+				}
+				tOut[i] = tAdd ? tOut[i] + v * tGain : v * tGain;
+				mPhase += inc;
+				mPhase -= std::floor(mPhase);
+			}
+		}
+
+		void reset(float tPhase = 0) { mPhase = tPhase; }
+		void setShape(OscillatorShape tShape) { mShape = tShape; }
+		OscillatorShape getShape() const { return mShape; }
+	private:
+		// Parabolic sine approximation (max error ~0.1%) of a [0;1) phase.
+		static float _sine(float tPhase) {
+			float x = 1.f - 2.f * tPhase;
+			float y = 4.f * x * (1.f - std::fabs(x));
+			return 0.225f * (y * std::fabs(y) - y) + y;
+		}
+#ifdef FSOAL_SYNTH_SSE2
+		static __m128 _abs(__m128 tV) {
+			return _mm_andnot_ps(_mm_set1_ps(-0.f), tV);
+		}
+		static __m128 _wrap(__m128 tPhase) {
+			// Phase is never negative, so truncation works as floor.
+			return _mm_sub_ps(tPhase, _mm_cvtepi32_ps(_mm_cvttps_epi32(tPhase)));
+		}
+		static __m128 _sine(__m128 tPhase) {
+			__m128 x = _mm_sub_ps(_mm_set1_ps(1.f), _mm_add_ps(tPhase, tPhase));
+			__m128 y = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.f), x), _mm_sub_ps(_mm_set1_ps(1.f), _abs(x)));
+			return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.225f), _mm_sub_ps(_mm_mul_ps(y, _abs(y)), y)), y);
+		}
+#endif
+
+		OscillatorShape mShape;
+		float mPhase = 0;
+		uint32_t mSeed = 0x9E3779B9u;
+	};
+
+	// Linear attack-decay-sustain-release envelope.
+	struct Envelope {
+	public:
+		Envelope(float tAttack = 0.01f, float tDecay = 0.1f, float tSustain = 0.7f, float tRelease = 0.2f)
+			: mAttack(tAttack), mDecay(tDecay), mSustain(tSustain), mRelease(tRelease) { }
+
+		void noteOn() { mStage = ES_ATTACK; }
+		void noteOff() {
+			if(mStage == ES_IDLE) return;
+			mStage = ES_RELEASE;
+			mReleaseLevel = mValue;
+		}
+
+		// Multiplies given block by the envelope.
+		void apply(float* tBuffer, size_t tFrames, unsigned int tSampleRate) {
+			float dt = 1.f / static_cast<float>(tSampleRate);
+			size_t i = 0;
+			while(i < tFrames) {
+				// Find current segment: its slope, target and how many frames it lasts.
+				float slope = 0, target = mValue;
+				switch(mStage) {
+				case ES_ATTACK: target = 1.f; slope = mAttack > 0 ? dt / mAttack : 1.f; break;
+				case ES_DECAY: target = mSustain; slope = mDecay > 0 ? -dt * (1.f - mSustain) / mDecay : mSustain - mValue; break;
+				case ES_RELEASE: target = 0; slope = mRelease > 0 ? -dt * mReleaseLevel / mRelease : -mValue; break;
+				default: break;
+				}
+				if(slope == 0) {
+					if(mStage == ES_RELEASE) mStage = ES_IDLE;
+					_ramp(tBuffer + i, tFrames - i, mValue, 0);
+					return;
+				}
+				size_t left = static_cast<size_t>(std::ceil((target - mValue) / slope));
+				if(left == 0) left = 1;
+				size_t count = left < tFrames - i ? left : tFrames - i;
+				_ramp(tBuffer + i, count, mValue, slope);
+				mValue += slope * static_cast<float>(count);
+				i += count;
+				if(count == left) {
+					mValue = target;
+					mStage = mStage == ES_ATTACK ? ES_DECAY : (mStage == ES_DECAY ? ES_SUSTAIN : ES_IDLE);
+				}
+			}
+		}
+
+		bool isActive() const { return mStage != ES_IDLE; }
+		float getValue() const { return mValue; }
+		void set(float tAttack, float tDecay, float tSustain, float tRelease) {
+			mAttack = tAttack; mDecay = tDecay; mSustain = tSustain; mRelease = tRelease;
+		}
+	private:
+		enum Stage { ES_IDLE, ES_ATTACK, ES_DECAY, ES_SUSTAIN, ES_RELEASE };
+
+		static void _ramp(float* tBuffer, size_t tFrames, float tStart, float tSlope) {
+			size_t i = 0;
+#ifdef FSOAL_SYNTH_SSE2
+			__m128 v = _mm_add_ps(_mm_set1_ps(tStart), _mm_mul_ps(_mm_set1_ps(tSlope), _mm_setr_ps(0, 1, 2, 3)));
+			const __m128 step = _mm_set1_ps(tSlope * 4.f);
+			for(; i + 4 <= tFrames; i += 4) {
+				_mm_storeu_ps(tBuffer + i, _mm_mul_ps(_mm_loadu_ps(tBuffer + i), v));
+				v = _mm_add_ps(v, step);
+			}
+#endif
+			for(; i < tFrames; i++)
+				tBuffer[i] *= tStart + tSlope * static_cast<float>(i);
+		}
+
+		float mAttack, mDecay, mSustain, mRelease;
+		float mValue = 0, mReleaseLevel = 0;
+		Stage mStage = ES_IDLE;
+	};
+
+}
+
+#endif // !FS_OAL_SYNTH
@@ -0,0 +1,105 @@
+#ifndef FS_OAL_WORKER
+#define FS_OAL_WORKER
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+#include "stats.hpp"
+
+namespace FSOAL {
+
+	// Small thread pool that runs audio side jobs (ray batches, decoding and etc.)
+	// off the main thread. Shared by every FSOAL subsystem.
+	class Workers {
+	public:
+		static Workers& get() {
+			static Workers instance;
+			return instance;
+		}
+
+		void submit(std::function<void()> tJob) {
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mJobs.push_back(std::move(tJob));
+			}
+			FSOAL_STAT(StatsCounters::add(SC_LOAD_QUEUE, 1));
+			mWake.notify_one();
+		}
+
+		size_t getThreadCount() const { return mThreads.size(); }
+
+		~Workers() {
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mQuit = true;
+			}
+			mWake.notify_all();
+			for(auto& t : mThreads) t.join();
+		}
+	private:
+		Workers() {
+			unsigned int count = std::thread::hardware_concurrency() / 2;
+			if(count < 1) count = 1;
+			if(count > 4) count = 4;
+			for(unsigned int i = 0; i < count; i++)
+				mThreads.emplace_back([this]() { _run(); });
+		}
+		Workers(const Workers&) = delete;
+		Workers& operator=(const Workers&) = delete;
+
+		void _run() {
+			while(true) {
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> lock(mMutex);
+					mWake.wait(lock, [this]() { return mQuit || !mJobs.empty(); });
+					if(mQuit && mJobs.empty()) return;
+					job = std::move(mJobs.front());
+					mJobs.pop_front();
+				}
+				FSOAL_STAT(StatsCounters::add(SC_LOAD_QUEUE, -1));
+				job();
+			}
+		}
+
+		std::vector<std::thread> mThreads;
+		std::deque<std::function<void()>> mJobs;
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		bool mQuit = false;
+	};
+
+	// Tracks a set of jobs submitted to Workers so the owner can wait only for its own work.
+	class WorkGroup {
+	public:
+		~WorkGroup() { wait(); }
+
+		void run(std::function<void()> tJob) {
+			mPending.fetch_add(1);
+			Workers::get().submit([this, job = std::move(tJob)]() {
+				job();
+				std::lock_guard<std::mutex> lock(mMutex);
+				if(mPending.fetch_sub(1) == 1) mDone.notify_all();
+			});
+		}
+
+		void wait() {
+			std::unique_lock<std::mutex> lock(mMutex);
+			mDone.wait(lock, [this]() { return mPending.load() == 0; });
+		}
+
+		bool isDone() const { return mPending.load() == 0; }
+	private:
+		std::atomic<int> mPending{0};
+		std::mutex mMutex;
+		std::condition_variable mDone;
+	};
+
+}
+
+#endif // !FS_OAL_WORKER
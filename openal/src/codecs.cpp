@@ -0,0 +1,320 @@
+// Decoder library: dr_wav, stb_vorbis and opusfile backends plus the baseline dr_mp3/dr_flac
+// build, and runtime selection between dr_mp3/dr_flac variants built for wider instruction sets.
+
+#include <cstring>
+#include <cstdlib>
+#ifndef _MSC_VER
+	#include <strings.h>
+#endif
+
+#define FSOAL_CODECS_SUFFIX Base
+#include "codecs_variant.inl"
+
+#if defined(__GNUC__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define DRWAV_API static
+#define DRWAV_PRIVATE static
+#define DR_WAV_IMPLEMENTATION
+#include "../include/dr_libs/dr_wav.hpp"
+#if defined(__GNUC__)
+	#pragma GCC diagnostic pop
+#endif
+
+// [!NOTE]
+// Ogg Vorbis (stb_vorbis, not shipped: stb_vorbis.c goes to include/stb_vorbis/) and Ogg Opus (opusfile)
+// are switched by FSOAL_VORBIS and FSOAL_OPUS CMake options (both off by default),
+// which define FSOAL_HAS_VORBIS and FSOAL_HAS_OPUS.
+#ifdef FSOAL_HAS_VORBIS
+	#include "../include/stb_vorbis/stb_vorbis.c"
+#endif
+#ifdef FSOAL_HAS_OPUS
+	#include <opusfile.h>
+#endif
+
+#if defined(FSOAL_CODECS_SSE41) || defined(FSOAL_CODECS_AVX2)
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#endif
+#endif
+
+namespace FSOAL {
+
+#ifdef FSOAL_CODECS_SSE41
+	const DecoderBackend& _mp3BackendSse41();
+	const DecoderBackend& _flacBackendSse41();
+#endif
+#ifdef FSOAL_CODECS_AVX2
+	const DecoderBackend& _mp3BackendAvx2();
+	const DecoderBackend& _flacBackendAvx2();
+#endif
+
+#if defined(FSOAL_HAS_VORBIS) || defined(FSOAL_HAS_OPUS)
+	// Reads LOOPSTART with LOOPLENGTH or LOOPEND (in frames) from Vorbis-style comments.
+	static bool _loopFromComments(char** tComments, int tCount, uint64_t tFrames, uint64_t* tStart, uint64_t* tEnd) {
+		bool hasStart = false, hasLength = false, hasEnd = false;
+		uint64_t start = 0, length = 0, end = 0;
+		for(int i = 0; i < tCount; i++) {
+			const char* c = tComments[i];
+			if(!c) continue;
+#ifdef _MSC_VER
+			auto match = [c](const char* tKey) { return _strnicmp(c, tKey, strlen(tKey)) == 0; };
+#else
+			auto match = [c](const char* tKey) { return strncasecmp(c, tKey, strlen(tKey)) == 0; };
+#endif
+			if(match("LOOPSTART=")) { start = strtoull(c + 10, nullptr, 10); hasStart = true; }
+			else if(match("LOOPLENGTH=")) { length = strtoull(c + 11, nullptr, 10); hasLength = true; }
+			else if(match("LOOPEND=")) { end = strtoull(c + 8, nullptr, 10); hasEnd = true; }
+		}
+		if(!hasStart) return false;
+		if(hasLength) end = start + length;
+		else if(!hasEnd) end = tFrames;
+		if(start >= end || end > tFrames) return false;
+		*tStart = start;
+		*tEnd = end;
+		return true;
+	}
+#endif
+
+	static const DecoderBackend& _wavBackend() {
+		static const DecoderBackend backend{
+			AF_WAV,
+			[](const char* tSrc, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				drwav* wav = new drwav;
+				if(!drwav_init_file(wav, tSrc, NULL)) { delete wav; return nullptr; }
+				*tChannels = wav->channels;
+				*tSampleRate = wav->sampleRate;
+				*tFrames = wav->totalPCMFrameCount;
+				return wav;
+			},
+			[](const void* tData, size_t tSize, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				drwav* wav = new drwav;
+				if(!drwav_init_memory(wav, tData, tSize, NULL)) { delete wav; return nullptr; }
+				*tChannels = wav->channels;
+				*tSampleRate = wav->sampleRate;
+				*tFrames = wav->totalPCMFrameCount;
+				return wav;
+			},
+			[](void* tHandle, uint64_t tFrames, int16_t* tOut) -> uint64_t {
+				return drwav_read_pcm_frames_s16(static_cast<drwav*>(tHandle), tFrames, tOut);
+			},
+			[](void* tHandle, uint64_t tFrames, float* tOut) -> uint64_t {
+				return drwav_read_pcm_frames_f32(static_cast<drwav*>(tHandle), tFrames, tOut);
+			},
+			[](void* tHandle, uint64_t tFrame) -> bool {
+				return drwav_seek_to_pcm_frame(static_cast<drwav*>(tHandle), tFrame);
+			},
+			[](void* tHandle) {
+				drwav_uninit(static_cast<drwav*>(tHandle));
+				delete static_cast<drwav*>(tHandle);
+			},
+			nullptr
+		};
+		return backend;
+	}
+#ifdef FSOAL_HAS_VORBIS
+	static const DecoderBackend& _vorbisBackend() {
+		static const DecoderBackend backend{
+			AF_VORBIS,
+			[](const char* tSrc, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				int error = 0;
+				stb_vorbis* vorbis = stb_vorbis_open_filename(tSrc, &error, NULL);
+				if(!vorbis) return nullptr;
+				stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+				*tChannels = static_cast<unsigned short>(info.channels);
+				*tSampleRate = info.sample_rate;
+				*tFrames = stb_vorbis_stream_length_in_samples(vorbis);
+				return vorbis;
+			},
+			[](const void* tData, size_t tSize, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				int error = 0;
+				stb_vorbis* vorbis = stb_vorbis_open_memory(static_cast<const unsigned char*>(tData), static_cast<int>(tSize), &error, NULL);
+				if(!vorbis) return nullptr;
+				stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+				*tChannels = static_cast<unsigned short>(info.channels);
+				*tSampleRate = info.sample_rate;
+				*tFrames = stb_vorbis_stream_length_in_samples(vorbis);
+				return vorbis;
+			},
+			[](void* tHandle, uint64_t tFrames, int16_t* tOut) -> uint64_t {
+				stb_vorbis* vorbis = static_cast<stb_vorbis*>(tHandle);
+				int channels = stb_vorbis_get_info(vorbis).channels;
+				return static_cast<uint64_t>(stb_vorbis_get_samples_short_interleaved(vorbis, channels, tOut, static_cast<int>(tFrames * channels)));
+			},
+			[](void* tHandle, uint64_t tFrames, float* tOut) -> uint64_t {
+				stb_vorbis* vorbis = static_cast<stb_vorbis*>(tHandle);
+				int channels = stb_vorbis_get_info(vorbis).channels;
+				return static_cast<uint64_t>(stb_vorbis_get_samples_float_interleaved(vorbis, channels, tOut, static_cast<int>(tFrames * channels)));
+			},
+			[](void* tHandle, uint64_t tFrame) -> bool {
+				return stb_vorbis_seek(static_cast<stb_vorbis*>(tHandle), static_cast<unsigned int>(tFrame)) != 0;
+			},
+			[](void* tHandle) {
+				stb_vorbis_close(static_cast<stb_vorbis*>(tHandle));
+			},
+			[](void* tHandle, uint64_t tFrames, uint64_t* tStart, uint64_t* tEnd) -> bool {
+				stb_vorbis_comment comment = stb_vorbis_get_comment(static_cast<stb_vorbis*>(tHandle));
+				return _loopFromComments(comment.comment_list, comment.comment_list_length, tFrames, tStart, tEnd);
+			}
+		};
+		return backend;
+	}
+#endif
+#ifdef FSOAL_HAS_OPUS
+	static const DecoderBackend& _opusBackend() {
+		static const DecoderBackend backend{
+			AF_OPUS,
+			[](const char* tSrc, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				int error = 0;
+				OggOpusFile* opus = op_open_file(tSrc, &error);
+				if(!opus) return nullptr;
+				*tChannels = static_cast<unsigned short>(op_channel_count(opus, -1));
+				// Opus always decodes at 48 kHz.
+				*tSampleRate = 48000;
+				ogg_int64_t total = op_pcm_total(opus, -1);
+				*tFrames = total > 0 ? static_cast<uint64_t>(total) : 0;
+				return opus;
+			},
+			[](const void* tData, size_t tSize, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				int error = 0;
+				OggOpusFile* opus = op_open_memory(static_cast<const unsigned char*>(tData), tSize, &error);
+				if(!opus) return nullptr;
+				*tChannels = static_cast<unsigned short>(op_channel_count(opus, -1));
+				*tSampleRate = 48000;
+				ogg_int64_t total = op_pcm_total(opus, -1);
+				*tFrames = total > 0 ? static_cast<uint64_t>(total) : 0;
+				return opus;
+			},
+			[](void* tHandle, uint64_t tFrames, int16_t* tOut) -> uint64_t {
+				OggOpusFile* opus = static_cast<OggOpusFile*>(tHandle);
+				int channels = op_channel_count(opus, -1);
+				uint64_t read = 0;
+				// op_read returns at most one packet per call.
+				while(read < tFrames) {
+					int left = static_cast<int>((tFrames - read) * channels);
+					int frames = op_read(opus, tOut + read * channels, left, NULL);
+					if(frames <= 0) break;
+					read += static_cast<uint64_t>(frames);
+				}
+				return read;
+			},
+			[](void* tHandle, uint64_t tFrames, float* tOut) -> uint64_t {
+				OggOpusFile* opus = static_cast<OggOpusFile*>(tHandle);
+				int channels = op_channel_count(opus, -1);
+				uint64_t read = 0;
+				while(read < tFrames) {
+					int left = static_cast<int>((tFrames - read) * channels);
+					int frames = op_read_float(opus, tOut + read * channels, left, NULL);
+					if(frames <= 0) break;
+					read += static_cast<uint64_t>(frames);
+				}
+				return read;
+			},
+			[](void* tHandle, uint64_t tFrame) -> bool {
+				return op_pcm_seek(static_cast<OggOpusFile*>(tHandle), static_cast<ogg_int64_t>(tFrame)) == 0;
+			},
+			[](void* tHandle) {
+				op_free(static_cast<OggOpusFile*>(tHandle));
+			},
+			[](void* tHandle, uint64_t tFrames, uint64_t* tStart, uint64_t* tEnd) -> bool {
+				const OpusTags* tags = op_tags(static_cast<OggOpusFile*>(tHandle), -1);
+				return tags && _loopFromComments(tags->user_comments, tags->comments, tFrames, tStart, tEnd);
+			}
+		};
+		return backend;
+	}
+#endif
+
+	static DecoderSimd _detectSimd() {
+		DecoderSimd simd = DS_NONE;
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		// AVX2 also needs the OS to save YMM registers.
+		bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+		bool avx2 = false;
+		if(avx && maxLeaf >= 7) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+	#else
+		__builtin_cpu_init();
+		bool sse2 = __builtin_cpu_supports("sse2");
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+	#endif
+		if(sse2) simd = DS_SSE2;
+	#ifdef FSOAL_CODECS_SSE41
+		if(sse2 && sse41) simd = DS_SSE41;
+	#endif
+	#ifdef FSOAL_CODECS_AVX2
+		if(sse2 && sse41 && avx2) simd = DS_AVX2;
+	#endif
+		(void)sse41; (void)avx2;
+#endif
+		return simd;
+	}
+
+	static DecoderSimd& _currentSimd() {
+		static DecoderSimd simd = getDecoderSimdSupport();
+		return simd;
+	}
+	static std::vector<const DecoderBackend*>& _backendList() {
+		static std::vector<const DecoderBackend*> backends;
+		return backends;
+	}
+	static void _buildBackends(DecoderSimd tSimd) {
+		const DecoderBackend* mp3 = &_mp3BackendBase();
+		const DecoderBackend* flac = &_flacBackendBase();
+#ifdef FSOAL_CODECS_SSE41
+		if(tSimd >= DS_SSE41) { mp3 = &_mp3BackendSse41(); flac = &_flacBackendSse41(); }
+#endif
+#ifdef FSOAL_CODECS_AVX2
+		if(tSimd >= DS_AVX2) { mp3 = &_mp3BackendAvx2(); flac = &_flacBackendAvx2(); }
+#endif
+		(void)tSimd;
+		_backendList() = {
+			&_wavBackend(), mp3, flac,
+#ifdef FSOAL_HAS_VORBIS
+			&_vorbisBackend(),
+#endif
+#ifdef FSOAL_HAS_OPUS
+			&_opusBackend(),
+#endif
+		};
+	}
+
+	const std::vector<const DecoderBackend*>& _decoderBackends() {
+		static bool built = (_buildBackends(_currentSimd()), true);
+		(void)built;
+		return _backendList();
+	}
+
+	DecoderSimd getDecoderSimdSupport() {
+		static const DecoderSimd support = _detectSimd();
+		return support;
+	}
+	DecoderSimd getDecoderSimd() { return _currentSimd(); }
+	DecoderSimd setDecoderSimd(DecoderSimd tSimd) {
+		if(tSimd > getDecoderSimdSupport()) tSimd = getDecoderSimdSupport();
+		_decoderBackends();
+		_currentSimd() = tSimd;
+		_buildBackends(tSimd);
+		return tSimd;
+	}
+	const char* getDecoderSimdName(DecoderSimd tSimd) {
+		switch(tSimd) {
+		case DS_SSE2: return "sse2";
+		case DS_SSE41: return "sse4.1";
+		case DS_AVX2: return "avx2";
+		default: return "none";
+		}
+	}
+
+}
@@ -0,0 +1,3 @@
+// dr_mp3/dr_flac built with AVX2 (-mavx2 or /arch:AVX2), picked at runtime by codecs.cpp.
+#define FSOAL_CODECS_SUFFIX Avx2
+#include "codecs_variant.inl"
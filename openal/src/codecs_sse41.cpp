@@ -0,0 +1,3 @@
+// dr_mp3/dr_flac built with SSE4.1 (-msse4.1), picked at runtime by codecs.cpp.
+#define FSOAL_CODECS_SUFFIX Sse41
+#include "codecs_variant.inl"
@@ -0,0 +1,109 @@
+// dr_mp3 and dr_flac compiled for one instruction set.
+// Included by every codecs*.cpp with FSOAL_CODECS_SUFFIX set to the variant name.
+// All dr_libs functions get internal linkage, so variants built with different flags can't
+// be mixed up by the linker. Keep standard library templates out of here for the same reason:
+// their out-of-line copies are shared between translation units.
+
+#ifndef FSOAL_CODECS_SUFFIX
+	#error "FSOAL_CODECS_SUFFIX must be defined before including codecs_variant.inl"
+#endif
+
+#if defined(__GNUC__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define DRMP3_API static
+#define DRMP3_PRIVATE static
+#define DR_MP3_IMPLEMENTATION
+#include "../include/dr_libs/dr_mp3.hpp"
+#define DRFLAC_API static
+#define DRFLAC_PRIVATE static
+#define DR_FLAC_IMPLEMENTATION
+#include "../include/dr_libs/dr_flac.hpp"
+#if defined(__GNUC__)
+	#pragma GCC diagnostic pop
+#endif
+
+#include "../include/codecs.hpp"
+
+#define FSOAL_CODECS_JOIN2(a, b) a##b
+#define FSOAL_CODECS_JOIN(a, b) FSOAL_CODECS_JOIN2(a, b)
+
+namespace FSOAL {
+
+	const DecoderBackend& FSOAL_CODECS_JOIN(_mp3Backend, FSOAL_CODECS_SUFFIX)() {
+		static const DecoderBackend backend{
+			AF_MP3,
+			[](const char* tSrc, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				drmp3* mp3 = new drmp3;
+				if(!drmp3_init_file(mp3, tSrc, NULL)) { delete mp3; return nullptr; }
+				*tChannels = static_cast<unsigned short>(mp3->channels);
+				*tSampleRate = mp3->sampleRate;
+				// Counting frames scans the whole file, so seek back to the start afterwards.
+				*tFrames = drmp3_get_pcm_frame_count(mp3);
+				drmp3_seek_to_pcm_frame(mp3, 0);
+				return mp3;
+			},
+			[](const void* tData, size_t tSize, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				drmp3* mp3 = new drmp3;
+				if(!drmp3_init_memory(mp3, tData, tSize, NULL)) { delete mp3; return nullptr; }
+				*tChannels = static_cast<unsigned short>(mp3->channels);
+				*tSampleRate = mp3->sampleRate;
+				*tFrames = drmp3_get_pcm_frame_count(mp3);
+				drmp3_seek_to_pcm_frame(mp3, 0);
+				return mp3;
+			},
+			[](void* tHandle, uint64_t tFrames, int16_t* tOut) -> uint64_t {
+				return drmp3_read_pcm_frames_s16(static_cast<drmp3*>(tHandle), tFrames, tOut);
+			},
+			[](void* tHandle, uint64_t tFrames, float* tOut) -> uint64_t {
+				return drmp3_read_pcm_frames_f32(static_cast<drmp3*>(tHandle), tFrames, tOut);
+			},
+			[](void* tHandle, uint64_t tFrame) -> bool {
+				return drmp3_seek_to_pcm_frame(static_cast<drmp3*>(tHandle), tFrame);
+			},
+			[](void* tHandle) {
+				drmp3_uninit(static_cast<drmp3*>(tHandle));
+				delete static_cast<drmp3*>(tHandle);
+			},
+			nullptr
+		};
+		return backend;
+	}
+	const DecoderBackend& FSOAL_CODECS_JOIN(_flacBackend, FSOAL_CODECS_SUFFIX)() {
+		static const DecoderBackend backend{
+			AF_FLAC,
+			[](const char* tSrc, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				drflac* flac = drflac_open_file(tSrc, NULL);
+				if(!flac) return nullptr;
+				*tChannels = flac->channels;
+				*tSampleRate = flac->sampleRate;
+				*tFrames = flac->totalPCMFrameCount;
+				return flac;
+			},
+			[](const void* tData, size_t tSize, unsigned short* tChannels, unsigned int* tSampleRate, uint64_t* tFrames) -> void* {
+				drflac* flac = drflac_open_memory(tData, tSize, NULL);
+				if(!flac) return nullptr;
+				*tChannels = flac->channels;
+				*tSampleRate = flac->sampleRate;
+				*tFrames = flac->totalPCMFrameCount;
+				return flac;
+			},
+			[](void* tHandle, uint64_t tFrames, int16_t* tOut) -> uint64_t {
+				return drflac_read_pcm_frames_s16(static_cast<drflac*>(tHandle), tFrames, tOut);
+			},
+			[](void* tHandle, uint64_t tFrames, float* tOut) -> uint64_t {
+				return drflac_read_pcm_frames_f32(static_cast<drflac*>(tHandle), tFrames, tOut);
+			},
+			[](void* tHandle, uint64_t tFrame) -> bool {
+				return drflac_seek_to_pcm_frame(static_cast<drflac*>(tHandle), tFrame);
+			},
+			[](void* tHandle) {
+				drflac_close(static_cast<drflac*>(tHandle));
+			},
+			nullptr
+		};
+		return backend;
+	}
+
+}